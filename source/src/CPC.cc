@@ -164,11 +164,21 @@ void CPC::run(bool frame) {
             ++cycles;
         }
     } else {
-        while (cycles++ < 16 * FRAME_TIME_CPC) {
+        while (cycles < 16 * FRAME_TIME_CPC) {
             clock();
             generateSound();
+            ++cycles;
         }
     }
+
+    frameStart += static_cast<uint32_t>(cycles);
+    if (psgRecorder.recording) {
+        psgRecorder.frame();
+    }
+    if (micRecorder.recording) {
+        micRecorder.frame(frameStart);
+    }
+    tape.frame();
 }
 
 void CPC::generateSound() {
@@ -270,6 +280,9 @@ void CPC::clock() {
                             | (expBit ? 0x20 : 0x00)
                             | ((ga.crtc.vSync || ga.crtc.vSyncForced) ? 0x1 : 0x0);
                         z80.d = ppi.readPortB();
+                        if (relay) {
+                            ++tape.reads;
+                        }
                     } else if (z80.wr) {
                         ppi.writePortB(z80.d);
                         ga.crtc.vSyncForced = ppi.portB & 0x1;
@@ -293,6 +306,11 @@ void CPC::clock() {
                     break;
             }
 
+            // Cassette write data is PPI port C, bit 5.
+            if (z80.wr && micRecorder.recording) {
+                micRecorder.write(!ppi.inputHiC && (ppi.regC & 0x20), frameStart + static_cast<uint32_t>(cycles));
+            }
+
             // Update the keyboard status if higher port C is outputting the row.
             if (!ppi.inputLoC) {
                 psg.setPortA(keys[ppi.portC & 0x0F]);
@@ -309,6 +327,9 @@ void CPC::clock() {
                         break;
                     case 0x80:
                         psg.write(ppi.portA);
+                        if (psgRecorder.recording) {
+                            psgRecorder.write(psg.a, psg.r[psg.a & 0x0F]);
+                        }
                         break;
                     case 0xC0:
                         psg.addr(ppi.portA);
@@ -327,8 +348,9 @@ void CPC::clock() {
         psg.clock();
     }
 
-    // The FDC chip is clocked at 4MHz, only rising edges.
-    if (cpcDisk && ga.fdcClock()) {
+    // The FDC chip is clocked at 4MHz, only rising edges, and only while
+    // it has work to do.
+    if (cpcDisk && !fdc765.sleeping && ga.fdcClock()) {
         fdc765.clock();
     }
 
@@ -414,6 +436,13 @@ void CPC::clock() {
             z80.d = 0xFF;
         }
 
+        if (flashTap && z80.state == Z80State::ST_OCF_T4L_RFSH2) {
+            checkTapeTraps();
+        }
+        if (flashDsk && z80.state == Z80State::ST_OCF_T4L_RFSH2) {
+            checkDiskTraps();
+        }
+
         z80.clock();
         ga.z80_c = z80.c;
     }
@@ -429,6 +458,7 @@ void CPC::reset() {
     psgReset();
     fdc765.reset();
     ppi.writeControlPort(0x9B);
+    findDiskTraps();
 }
 
 void CPC::psgReset() {
@@ -534,6 +564,230 @@ void CPC::setPage(uint_fast8_t page, uint_fast8_t bank) {
     mem[page] = &ram[addr];
 }
 
+uint_fast8_t CPC::readMemory(uint_fast16_t a) {
+
+    a &= 0xFFFF;
+    switch (a >> 14) {
+        case 0:
+            return ga.lowerRom ? loRom[a & 0x3FFF] : mem[0][a & 0x3FFF];
+        case 3:
+            return ga.upperRom ? hiRom[a & 0x3FFF] : mem[3][a & 0x3FFF];
+        default:
+            return mem[a >> 14][a & 0x3FFF];
+    }
+}
+
+void CPC::writeMemory(uint_fast16_t a, uint_fast8_t d) {
+
+    a &= 0xFFFF;
+    mem[a >> 14][a & 0x3FFF] = d;
+}
+
+void CPC::checkTapeTraps() {
+
+    // The jumpblock entry is a LOW JUMP (RST 1) to the lower ROM routine.
+    uint_fast16_t entry = (mem[CAS_READ >> 14][(CAS_READ + 1) & 0x3FFF]
+            | (mem[CAS_READ >> 14][(CAS_READ + 2) & 0x3FFF] << 8)) & 0x3FFF;
+
+    // This is catched on the REFRESH cycles, so PC is the address plus one.
+    if (ga.lowerRom && z80.pc.w == entry + 1
+            && mem[CAS_READ >> 14][CAS_READ & 0x3FFF] == 0xCF
+            && tape.tapData.size()) {
+        trapCasRead();
+    }
+}
+
+void CPC::trapCasRead() {
+
+    // Find the next record with the expected sync byte, which is in A.
+    // The records are walked without moving the tape, which moves only
+    // past the one loaded. If there is none, the firmware routine will run
+    // normally.
+    size_t block = tape.tapPointer;
+    bool wrapped = false;
+    while (true) {
+        if (block + 2 < tape.tapData.size()) {
+            size_t length = tape.tapData[block] | (tape.tapData[block + 1] << 8);
+            if (length && block + 2 + length <= tape.tapData.size()
+                    && tape.tapData[block + 2] == z80.af.b.h) {
+                break;
+            }
+            block += 2 + length;
+        }
+
+        // TZX and CDT files are decoded as the tape plays.
+        while (block + 2 >= tape.tapData.size() && !tape.useSaveData
+                && (tape.source == TAPE_SOURCE_TZX || tape.source == TAPE_SOURCE_CDT)) {
+            tape.decode(tape.pulseData.size() + TAPE_DECODE_AHEAD);
+        }
+
+        if (block + 2 >= tape.tapData.size()) {
+            if (wrapped) {
+                return;
+            }
+            block = 0;
+            wrapped = true;
+        }
+
+        if (wrapped && block >= tape.tapPointer) {
+            return;
+        }
+    }
+    tape.tapPointer = block;
+
+    // A record is made of 256 byte segments, each one followed by its
+    // CRC, and padded to a whole segment.
+    uint16_t address = z80.hl.w;
+    uint16_t bytes = z80.de.w;
+    size_t length = tape.getBlockLength();
+    size_t offset = 3;
+    bool ok = true;
+
+    while (bytes) {
+        if (offset + CAS_SEGMENT_SIZE > length) {
+            ok = false;
+            break;
+        }
+
+        uint16_t crc = 0xFFFF;
+        for (size_t ii = 0; ii < CAS_SEGMENT_SIZE; ++ii) {
+            uint_fast8_t byte = tape.getBlockByte(offset + ii);
+            if (ii < bytes) {
+                writeMemory(address++, byte);
+            }
+
+            crc ^= byte << 8;
+            for (size_t jj = 0; jj < 8; ++jj) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+            }
+        }
+        bytes -= min<size_t>(bytes, CAS_SEGMENT_SIZE);
+        offset += CAS_SEGMENT_SIZE;
+
+        // The CRC is stored inverted, high byte first.
+        uint16_t stored = (tape.getBlockByte(offset) << 8) | tape.getBlockByte(offset + 1);
+        offset += 2;
+        if (stored != static_cast<uint16_t>(~crc)) {
+            ok = false;
+            break;
+        }
+    }
+
+    cout << "Loading - Sync: " << setw(3) << static_cast<size_t>(z80.af.b.h)
+        << "  Length: " << setw(5) << z80.de.w << (ok ? "" : "  Error") << endl;
+
+    // Carry set means success. Otherwise, A holds the error code.
+    if (ok) {
+        z80.af.b.l |= FLAG_C;
+    } else {
+        z80.af.b.h = 0x02;  // CRC error.
+        z80.af.b.l &= ~FLAG_C;
+    }
+    z80.hl.w = address;
+    z80.de.w = bytes;
+
+    // Advance tape
+    tape.nextTapBlock();
+
+    // Force RET
+    z80.decode(0xC9);
+    z80.startInstruction();
+
+    if (tape.tapPointer == 0) {
+        tape.rewind();
+    }
+}
+
+void CPC::findDiskTraps() {
+
+    biosReadSector = biosWriteSector = 0;
+    if (!cpcDisk || !extReady[AMSDOS_ROM]) {
+        return;
+    }
+
+    // The ROM header points to the command names, and is followed by the
+    // jumpblock. Each name ends with bit 7 set. The BIOS commands have a
+    // single character name, so they cannot be typed.
+    vector<uint8_t> const& amsdos = ext[AMSDOS_ROM].data;
+    size_t names = (amsdos[0x04] | (amsdos[0x05] << 8)) & 0x3FFF;
+    size_t start = names;
+    for (size_t index = 0; names < amsdos.size() && amsdos[names]; ++index) {
+        while (names < amsdos.size() && !(amsdos[names] & 0x80)) {
+            ++names;
+        }
+        if (names == start && names < amsdos.size()) {
+            size_t entry = 0x06 + 3 * index;
+            if (entry + 2 < amsdos.size() && amsdos[entry] == 0xC3) {
+                uint_fast16_t target = amsdos[entry + 1] | (amsdos[entry + 2] << 8);
+                if (amsdos[names] == BIOS_READ_SECTOR) {
+                    biosReadSector = target;
+                } else if (amsdos[names] == BIOS_WRITE_SECTOR) {
+                    biosWriteSector = target;
+                }
+            }
+        }
+        start = ++names;
+    }
+}
+
+void CPC::checkDiskTraps() {
+
+    if (ga.upperRom && romBank == AMSDOS_ROM) {
+        if (biosReadSector && z80.pc.w == biosReadSector + 1) {
+            trapBiosSector(false);
+        } else if (biosWriteSector && z80.pc.w == biosWriteSector + 1) {
+            trapBiosSector(true);
+        }
+    }
+}
+
+void CPC::trapBiosSector(bool write) {
+
+    // E is the drive. If there is no disk, the AMSDOS routine reports it.
+    Plus3Disk& drive = fdc765.drive[z80.de.b.l & 0x01];
+    if (!drive.disk || (write && drive.writeprot)) {
+        return;
+    }
+
+    // D is the track and C the sector ID. AMSDOS uses only one side.
+    // Sectors with errors are left to the AMSDOS routine and the FDC.
+    DSKFile::Track::Sector* sector = drive.findSector(z80.de.b.h, 0, z80.bc.b.l);
+    if (!sector) {
+        return;
+    }
+    size_t length = 0x80 << (sector->sectorSize & 0x07);
+    if (sector->dataSize < length) {
+        return;
+    }
+
+    // The buffer is at HL, always in RAM.
+    uint16_t address = z80.hl.w;
+    DSKFile& image = drive.images[drive.currentImage];
+    DSKSpan data = image.sectorData(*sector);
+    if (write) {
+        vector<uint8_t> bytes(data.begin(), data.end());
+        for (size_t ii = 0; ii < length; ++ii, ++address) {
+            bytes[ii] = mem[address >> 14][address & 0x3FFF];
+        }
+        image.store(*sector, bytes.data(), bytes.size());
+
+        // The FDC does not run, so it would not write the sector back.
+        fdc765.flush(false);
+    } else {
+        for (size_t ii = 0; ii < length; ++ii) {
+            writeMemory(address++, data.data[ii]);
+        }
+    }
+
+    // Carry set and A = 0 mean success.
+    z80.af.b.h = 0x00;
+    z80.af.b.l |= FLAG_C;
+
+    // Force RET
+    z80.decode(0xC9);
+    z80.startInstruction();
+}
+
 void CPC::setBrand(uint_fast8_t brandNumber) {
 
     brand = brandNumber & 0x7;
@@ -20,8 +20,10 @@
 #include "Z80.h"
 #include "Z80Defs.h"
 #include "PSG.h"
+#include "PSGRecorder.h"
 #include "FDC765.h"
 #include "Tape.h"
+#include "TapeRecorder.h"
 #include "config.h"
 
 #include "CommonDefs.h"
@@ -53,6 +55,16 @@ uint_fast8_t constexpr BRAND_SCHNEIDER = 0x05;
 uint_fast8_t constexpr BRAND_ORION = 0x06;
 uint_fast8_t constexpr BRAND_AMSTRAD = 0x07;
 
+/** CAS READ firmware jumpblock entry. */
+uint_fast16_t constexpr CAS_READ = 0xBCA1;
+/** Size of the segments in a cassette record, excluding the CRC. */
+size_t constexpr CAS_SEGMENT_SIZE = 256;
+/** AMSDOS expansion ROM number. */
+uint_fast8_t constexpr AMSDOS_ROM = 0x07;
+/** AMSDOS BIOS external commands. */
+uint8_t constexpr BIOS_READ_SECTOR = 0x84;
+uint8_t constexpr BIOS_WRITE_SECTOR = 0x85;
+
 /**
  * CPC
  *
@@ -80,10 +92,14 @@ class CPC {
         PPI ppi;
         /** PSG instance. */
         PSG psg;
+        /** PSG register write recorder. */
+        PSGRecorder psgRecorder;
         /** FDC 765 instance. */
         FDC765 fdc765;
         /** Tape drive. */
         Tape tape;
+        /** Tape output recorder. */
+        TapeRecorder micRecorder;
         /** Keyboard matrix. */
         uint_fast8_t keys[10];
 
@@ -99,6 +115,10 @@ class CPC {
         bool expBit = false;
 
         bool tapeSound = false;
+        /** Trap firmware tape routine. */
+        bool flashTap = false;
+        /** Trap AMSDOS sector routines. */
+        bool flashDsk = false;
 
         /** Tape signal level. */
         uint_fast8_t tapeLevel = 0;
@@ -108,6 +128,8 @@ class CPC {
         uint_fast32_t tapeSpeed = 0;
         /** Gate Array cycle counter. */
         uint_fast32_t cycles = 0;
+        /** Gate Array cycles before this frame. Wraps. */
+        uint32_t frameStart = 0;
 
         /** Moving Average filter for tape sound. */
         Filter filter;
@@ -140,6 +162,9 @@ class CPC {
         uint8_t* loRom = &rom[0x0000];
         /** Pointer to high ROM. */
         uint8_t* hiRom = &rom[0x4000];
+        /** AMSDOS sector routines, or zero if not found. */
+        uint_fast16_t biosReadSector = 0;
+        uint_fast16_t biosWriteSector = 0;
 
         bool updateMotor = false;
 
@@ -220,6 +245,52 @@ class CPC {
          */
         void setPage(uint_fast8_t page, uint_fast8_t bank);
 
+        /**
+         * Read a memory byte, as seen by the Z80.
+         *
+         * @param a Memory address to read.
+         * @return Read byte.
+         */
+        uint_fast8_t readMemory(uint_fast16_t a);
+
+        /**
+         * Write a memory byte. Writes always go to RAM.
+         *
+         * @param a Memory address to write.
+         * @param d Value to write.
+         */
+        void writeMemory(uint_fast16_t a, uint_fast8_t d);
+
+        /**
+         * Check if the CPC is about to execute the firmware tape routines.
+         *
+         * The routine is found through the CAS READ jumpblock entry, so
+         * the trap works with any firmware version.
+         */
+        void checkTapeTraps();
+
+        /**
+         * Trap CAS READ and copy a record from the tape to memory.
+         */
+        void trapCasRead();
+
+        /**
+         * Find the AMSDOS sector routines in the AMSDOS ROM, through its
+         * table of external commands.
+         */
+        void findDiskTraps();
+
+        /**
+         * Check if the CPC is about to execute the AMSDOS sector routines.
+         */
+        void checkDiskTraps();
+
+        /**
+         * Trap BIOS READ SECTOR or BIOS WRITE SECTOR, and copy the sector
+         * between the disk image and memory.
+         */
+        void trapBiosSector(bool write);
+
         /**
          * Reset the PSG.
          */
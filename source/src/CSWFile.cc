@@ -16,23 +16,18 @@
 #include "CSWFile.h"
 #include "Utils.h"
 
-#include <fstream>
+#include <algorithm>
 
 using namespace std;
 
-void CSWFile::load(std::string const& fileName) {
+// Inflated data is processed in chunks of this size.
+size_t constexpr CSW_CHUNK_SIZE = 0x10000;
 
-    char c;
+void CSWFile::load(std::string const& fileName) {
 
     magicIsOk = false;
 
-    ifstream ifs(fileName.c_str(), ifstream::binary);
-    if (ifs.good()) {
-        fileData.clear();
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
-
+    if (fileData.open(fileName) && fileData.size() > 0x20) {
         // CSW header is:
         // 0x00 - "Compressed Square Wave"
         // 0x16 - 0x1A
@@ -50,12 +45,19 @@ void CSWFile::load(std::string const& fileName) {
     }
 }
 
-void CSWFile::parse(std::vector<uint32_t> &pulseData,
+void CSWFile::parse(PulseData& pulseData,
+        std::set<size_t> &indexData,
+        std::set<size_t> &stopData) {
+
+    start(pulseData, indexData, stopData);
+    decode(pulseData, SIZE_MAX);
+}
+
+void CSWFile::start(PulseData& pulseData,
         std::set<size_t> &indexData,
         std::set<size_t> &stopData) {
 
     size_t pointer = 0;
-    size_t pulses = 0;
     rate = fileData[0x19] + 0x100 * fileData[0x1a];
 
     if (majorVersion == 0x01 && minorVersion == 0x01) {
@@ -63,9 +65,11 @@ void CSWFile::parse(std::vector<uint32_t> &pulseData,
         flags = fileData[0x1c];
         pointer = 0x20;
     } else if (majorVersion == 0x02 && minorVersion == 0x00) {
+        rate = getU32(fileData, 0x19);
         compression = fileData[0x21];
         flags = fileData[0x22];
-        cout << "CSW created with: " << &fileData[0x24] << endl;
+        cout << "CSW created with: "
+            << string(reinterpret_cast<char const*>(fileData.data() + 0x24), 16).c_str() << endl;
         pointer = 0x34 + fileData[0x23];
     }
 
@@ -99,35 +103,102 @@ void CSWFile::parse(std::vector<uint32_t> &pulseData,
             + 0x10000 * fileData[0x1f] + 0x1000000 * fileData[0x20];
 
         cout << "Expected pulses: " << expectedPulses << endl;
+    }
 
-        vector<uint8_t> deflated(fileData.begin() + pointer, fileData.end());
-        vector<uint8_t> inflated(5 * expectedPulses, 0x00);
+    pointer = min(pointer, fileData.size());
+    open(fileData.data() + pointer, fileData.size() - pointer, compression == 2);
+    decoded = 0;
+}
 
-        if (inflateBuffer(deflated, inflated)) {
-            fileData.resize(inflated.size() + pointer);
-            copy(inflated.begin(), inflated.end(), &fileData[pointer]);
-        }
-    }
+bool CSWFile::decode(PulseData& pulseData, size_t pulses) {
 
-    double pulse;
-    while (pointer < fileData.size()) {
-        if (fileData[pointer] == 0x00) {
-            pulse = fileData[pointer + 1]
-                + 0x100 * fileData[pointer + 2]
-                + 0x10000 * fileData[pointer + 3]
-                + 0x1000000 * fileData[pointer + 4];
-            pointer += 5;
-        } else {
-            pulse = fileData[pointer];
-            ++pointer;
+    uint32_t sample;
+    while (pulseData.size() < pulses) {
+        if (!readPulse(sample)) {
+            cout << "Got " << decoded << " pulses." << endl;
+            return true;
         }
 
-        ++pulses;
+        ++decoded;
+        double pulse = sample;
         pulse *= 3500000.0 / rate;
         pulseData.push_back(static_cast<uint32_t>(pulse));
     }
+    return false;
+}
+
+double CSWFile::progress() const {
+
+    size_t position = inflating ? inflater.consumed() : inputPos;
+    return inputSize ? static_cast<double>(position) / inputSize : 1.0;
+}
+
+void CSWFile::open(uint8_t const* data, size_t size, bool zlib) {
+
+    input = data;
+    inputSize = size;
+    inputPos = 0;
 
-    cout << "Got " << pulses << " pulses." << endl;
+    inflating = zlib;
+    chunkPos = chunkEnd = 0;
+    if (inflating) {
+        chunk.resize(CSW_CHUNK_SIZE);
+        inflater.start(data, size);
+    }
+}
+
+bool CSWFile::readPulse(uint32_t& pulse) {
+
+    uint8_t const* next;
+    size_t available;
+
+    if (inflating) {
+        // Keep at least a long pulse in the buffer.
+        if (chunkEnd - chunkPos < 5) {
+            refill();
+        }
+        next = &chunk[chunkPos];
+        available = chunkEnd - chunkPos;
+    } else {
+        next = input + inputPos;
+        available = inputSize - inputPos;
+    }
+
+    size_t length = 1;
+    if (!available) {
+        return false;
+    } else if (next[0]) {
+        pulse = next[0];
+    } else if (available >= 5) {
+        // Zero means the pulse is stored as a 32-bit value.
+        pulse = next[1] + 0x100 * next[2] + 0x10000 * next[3] + 0x1000000 * next[4];
+        length = 5;
+    } else {
+        return false;
+    }
+
+    if (inflating) {
+        chunkPos += length;
+    } else {
+        inputPos += length;
+    }
+    return true;
+}
+
+void CSWFile::refill() {
+
+    // Move the remaining bytes to the beginning and fill the rest.
+    copy(chunk.begin() + chunkPos, chunk.begin() + chunkEnd, chunk.begin());
+    chunkEnd -= chunkPos;
+    chunkPos = 0;
+
+    while (chunkEnd < chunk.size()) {
+        size_t bytes = inflater.read(&chunk[chunkEnd], chunk.size() - chunkEnd);
+        if (!bytes) {
+            break;
+        }
+        chunkEnd += bytes;
+    }
 }
 
 // vim: et:sw=4:ts=4
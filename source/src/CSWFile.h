@@ -15,11 +15,26 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <set>
+#include <string>
 #include <vector>
 
+#include "FileView.h"
+#include "PulseData.h"
+#include "Utils.h"
+
+/** CSWFile.h
+ *
+ * CSW file format implementation.
+ *
+ * Pulses are decoded as they are needed, and ZLIB compressed data is
+ * inflated in chunks, so large recordings start playing immediately.
+ * The same decoder is used for CSW blocks in TZX files.
+ */
+
 class CSWFile {
     public:
         CSWFile() :
@@ -38,13 +53,62 @@ class CSWFile {
         uint8_t compression;
         uint8_t flags;
 
-        std::vector<uint8_t> fileData;
+        FileView fileData;
         std::vector<uint8_t> romData;
 
         void load(std::string const& fileName);
-        void parse(std::vector<uint32_t> &pulseData,
+        void parse(PulseData& pulseData,
+                std::set<size_t> &indexData,
+                std::set<size_t> &stopData);
+
+        /**
+         * Read the header and prepare for decoding pulses.
+         */
+        void start(PulseData& pulseData,
                 std::set<size_t> &indexData,
                 std::set<size_t> &stopData);
+
+        /**
+         * Decode pulses until there are enough of them.
+         *
+         * @param pulses Number of pulses wanted in pulseData.
+         * @return True if the end of the file has been reached.
+         */
+        bool decode(PulseData& pulseData, size_t pulses);
+
+        /**
+         * Fraction of the file decoded so far.
+         */
+        double progress() const;
+
+        /**
+         * Decode RLE pulse data from a buffer, which must outlive the decoder.
+         *
+         * @param zlib True if the data is ZLIB compressed.
+         */
+        void open(uint8_t const* data, size_t size, bool zlib);
+
+        /**
+         * Read the next pulse, in samples.
+         *
+         * @return False at the end of the data.
+         */
+        bool readPulse(uint32_t& pulse);
+
+    private:
+        uint8_t const* input = nullptr;
+        size_t inputSize = 0;
+        size_t inputPos = 0;
+
+        bool inflating = false;
+        InflateStream inflater;
+        std::vector<uint8_t> chunk;     // Inflated data.
+        size_t chunkPos = 0;
+        size_t chunkEnd = 0;
+
+        size_t decoded = 0;             // Pulses decoded so far.
+
+        void refill();
 };
 
 // vim: et:sw=4:ts=4
@@ -38,6 +38,8 @@ void CpcScreen::setup() {
 
     cpc.channel.open(2, SAMPLE_RATE);
     cpc.channel.setSleepInterval(getNumber("soundsleep", 10));
+    cpc.channel.adaptive = (options["lowlatency"] == "yes");
+    cout << "Low latency sound: " << options["lowlatency"] << endl;
 
     cout << "Initialising Amstrad CPC..." << endl;
     // Select model and ROMs.
@@ -97,6 +99,17 @@ void CpcScreen::setup() {
     cpc.z80.zeroByte = options["z80type"] == "cmos" ? 0xFF : 0x00;
     cout << "Z80 type: " << options["z80type"] << endl;
 
+    // Other stuff.
+    cpc.flashTap = (options["flashtap"] == "yes");
+    cout << "FlashTAP: " << options["flashtap"] << endl;
+    cpc.flashDsk = (options["flashdsk"] == "yes");
+    cout << "FlashDSK: " << options["flashdsk"] << endl;
+    cpc.fdc765.fastMode = (options["fastdisk"] == "yes");
+    cout << "Fast disk: " << options["fastdisk"] << endl;
+    cpc.fdc765.drive[0].writeBack = (options["diskwrite"] == "yes");
+    cpc.fdc765.drive[1].writeBack = (options["diskwrite"] == "yes");
+    cout << "Disk write back: " << options["diskwrite"] << endl;
+
     // Screen settings.
     if (options["scanmode"] == "scanlines") {
         doubleScanMode = true;
@@ -115,7 +128,9 @@ void CpcScreen::setup() {
 
     xSize = GateArray::X_SIZE;
     ySize = GateArray::Y_SIZE / (doubleScanMode ? 1 : 2);
-    texture(xSize, ySize);
+    if (!headless) {
+        texture(xSize, ySize);
+    }
 
     cpc.tape.speed = 1.16;
     loadFiles();
@@ -126,8 +141,20 @@ void CpcScreen::setup() {
     bBorder = 0;
 
     wide = true;
-    reopenWindow(fullscreen);
-    setFullScreen(fullscreen);
+    if (headless) {
+        soundEnabled = false;
+    } else {
+        reopenWindow(fullscreen);
+        setFullScreen(fullscreen);
+    }
+
+    if (psgRecord) {
+        cpc.psgRecorder.start();
+    }
+    if (micRecord) {
+        // The Gate Array is clocked at 16MHz.
+        cpc.micRecorder.start(16000000.0, cpc.frameStart);
+    }
     cpc.tapeSound = tapeSound && soundEnabled;
     cpc.psgPlaySound(soundEnabled);
     cpc.setSoundRate(FRAME_TIME_CPC, syncToVideo);
@@ -148,13 +175,9 @@ void CpcScreen::loadFiles() {
 
             case FileTypes::FILETYPE_DSK:
                 {
-                    DSKFile dsk;
-                    dsk.load(*it);
-
-                    if (dsk.validFile) {
-                        cpc.fdc765.drive[0].images.push_back(dsk);
-                        cpc.fdc765.drive[0].imageNames.push_back(*it);
-                        cpc.fdc765.drive[0].disk = true;
+                    DSKFile const* dsk = loadDisk(*it);
+                    if (dsk) {
+                        cpc.fdc765.drive[0].addImage(*dsk, *it);
                     }
                 }
                 break;
@@ -164,10 +187,28 @@ void CpcScreen::loadFiles() {
                 break;
         }
     }
+
+    if (!options["driveb"].empty()) {
+        DSKFile const* dsk = loadDisk(options["driveb"]);
+        if (dsk) {
+            cpc.fdc765.drive[1].addImage(*dsk, options["driveb"]);
+        }
+    }
+
+    if (!options["tapeblock"].empty()) {
+        cpc.tape.seekBlock(getNumber("tapeblock", 0));
+    }
 }
 
 void CpcScreen::run() {
 
+    if (headless) {
+        for (uint32_t ii = 0; ii < headlessFrames; ++ii) {
+            cpc.run(true);
+        }
+        done = true;
+    }
+
     while (!done) {
         Clock clock;
         Time frameTime; // Emulated frame time
@@ -182,6 +223,12 @@ void CpcScreen::run() {
             pollEvents();
 
             cpc.run(!syncToVideo);
+
+            if (turboTape && cpc.tape.loading()) {
+                runTurbo();
+                continue;
+            }
+
             if (cpc.channel.commit()) {
                 cpc.playSound(true);
             }
@@ -216,6 +263,32 @@ void CpcScreen::run() {
             sleep(microseconds(20000));
         }
     }
+
+    if (psgRecord) {
+        cpc.psgRecorder.save(psgRecordName());
+    }
+    if (micRecord) {
+        cpc.micRecorder.save(micRecordName());
+    }
+    cpc.fdc765.flush(true);
+}
+
+void CpcScreen::runTurbo() {
+
+    // Sound is muted, and the screen is updated only now and then.
+    Clock clock;
+    cpc.playSound(false);
+    while (!done && !menu && cpc.tape.loading()) {
+        cpc.run(true);
+        if (clock.getElapsedTime() >= microseconds(TURBO_UPDATE_TIME)) {
+            clock.restart();
+            pollEvents();
+            update();
+        }
+    }
+
+    // Discard the samples generated during the turbo run.
+    cpc.channel.wrSample = 0;
 }
 
 void CpcScreen::update() {
@@ -228,7 +301,7 @@ void CpcScreen::update() {
 
     if (cpc.tape.pulseData.size()) {
         char str[64];
-        unsigned int percent = 100 * cpc.tape.pointer / cpc.tape.pulseData.size();
+        unsigned int percent = cpc.tape.percent();
         snprintf(str, 64, "SpecIde [%s(%s)] [%03u%%]",
                 SPECIDE_BUILD_DATE, SPECIDE_BUILD_COMMIT, percent);
         window.setTitle(str);
@@ -267,7 +340,8 @@ void CpcScreen::updateMenu() {
     ss << "F4:    Select next disk image." << endl;
     ss << "S-F4:  Select previous disk image." << endl;
     ss << "F5:    Reset." << endl;
-    ss << "F8:    Toggle PSG: AY-3-8912/YM-2149." << endl;
+    ss << "F8:    Toggle FlashTAP on/off." << endl;
+    ss << "S-F8:  Toggle PSG: AY-3-8912/YM-2149." << endl;
     ss << "F9:    Sound on / off." << endl;
     ss << "S-F9:  Tape sound on / off." << endl;
     ss << "F10:   Exit emulator." << endl;
@@ -387,7 +461,9 @@ void CpcScreen::togglePsgType() {
 
 void CpcScreen::toggleFlashTap() {
 
-    // FlashTAP is not supported on CPC yet.
+    cpc.tape.rewind();
+    cpc.flashTap = !cpc.flashTap;
+    cout << "FlashTAP: " << (cpc.flashTap ? "yes" : "no") << endl;
 }
 
 void CpcScreen::joystickHorizontalAxis(uint_fast32_t id, bool l, bool r) {
@@ -72,6 +72,11 @@ class CpcScreen : public Screen {
          */
         void run();
 
+        /**
+         * Run the emulation unthrottled while the tape is loading.
+         */
+        void runTurbo();
+
         /**
          * Exit the ZX Spectrum emulation.
          */
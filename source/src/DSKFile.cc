@@ -14,6 +14,7 @@
  */
 
 #include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -32,8 +33,7 @@ DSKFile::Track::Sector::Sector(uint_fast8_t track, uint_fast8_t side,
     sectorSize(size),
     fdcStatusReg1(status1),
     fdcStatusReg2(status2),
-    sectorLength(0x80 << size),
-    data(sectorLength, 0xFF) {
+    sectorLength(0x80 << size) {
 }
 
 DSKFile::Track::Track() :
@@ -49,11 +49,13 @@ DSKFile::Track::Track() :
     sectors(1, Sector(1, 0, 1, 2, 0, 0)) {
 }
 
-bool DSKFile::Track::load(vector<uint8_t> const& data, size_t offset) {
+bool DSKFile::Track::load(FileView const& data, size_t offset,
+        vector<uint8_t>& arena) {
 
     // Validate magic
-    magicOk = equal(&magic[0x00], &magic[0x0A], &data[offset]);
+    magicOk = equal(&magic[0x00], &magic[0x0A], data.data() + offset);
     if (magicOk) {
+        fileOffset = offset;
         trackNumber = data[offset + 0x10];
         sideNumber = data[offset + 0x11];
         sectorSize = data[offset + 0x14];
@@ -83,21 +85,34 @@ bool DSKFile::Track::load(vector<uint8_t> const& data, size_t offset) {
             s.sectorLength = data[secEntry + 7] * 0x100 + data[secEntry + 6];
             size_t size =
                 (s.sectorLength) ? s.sectorLength : (0x80 << s.sectorSize);
+            s.dataOffset = arena.size();
             if ((dataOffset + size) <= data.size()) {
-                s.data.assign(&data[dataOffset], &data[dataOffset + size]);
+                arena.insert(arena.end(), data.data() + dataOffset, data.data() + dataOffset + size);
+                s.fileOffset = dataOffset;
+                s.fileSize = size;
+                s.dataSize = size;
                 dataOffset += size;
             }
 
+            // Weak sectors hold several copies of the data.
+            if (s.sectorSize < 0x07 && s.fileSize > (0x80u << s.sectorSize)
+                    && (s.fileSize % (0x80u << s.sectorSize)) == 0) {
+                packCopies(s, arena);
+            }
+
             // Opera 32K protection hack.
             if (s.sectorLength == 0 && s.sectorSize == 0x08
-                    && s.track == 0x28 && s.sectorId == 0x08) {
-                s.data.assign(0x2000, 0x00);
+                    && s.track == 0x28 && s.sectorId == 0x08 && !sectors.empty()) {
+                arena.resize(s.dataOffset + 0x2000);
                 for (size_t ii = 0; ii < 0x2000; ++ii) {
-                    s.data[ii] = rand() & 0xFF;
+                    arena[s.dataOffset + ii] = rand() & 0xFF;
                 }
-                for (size_t ii = 0; ii < sectors.back().sectorLength; ++ii) {
-                    s.data[ii + 0x512] = sectors.back().data[ii];
+                Sector const& prev = sectors.back();
+                size_t prevSize = min(static_cast<size_t>(prev.sectorLength), prev.dataSize);
+                for (size_t ii = 0; ii < prevSize; ++ii) {
+                    arena[s.dataOffset + ii + 0x512] = arena[prev.dataOffset + ii];
                 }
+                s.dataSize = 0x2000;
             }
 
             sectors.push_back(s);
@@ -107,7 +122,7 @@ bool DSKFile::Track::load(vector<uint8_t> const& data, size_t offset) {
     return magicOk;
 }
 
-void DSKFile::Track::dump(vector<uint8_t>& buffer) {
+void DSKFile::Track::dump(vector<uint8_t>& buffer, DSKFile const& image) {
 
     size_t offset = buffer.size();
     buffer.insert(buffer.end(), 0x100, 0x00);
@@ -120,9 +135,10 @@ void DSKFile::Track::dump(vector<uint8_t>& buffer) {
     buffer[offset + 0x16] = gapLength;
     buffer[offset + 0x17] = fillerByte;
 
+    vector<uint8_t> data;
     for (size_t ii = 0; ii < numSectors; ++ii) {
         size_t base = offset + 0x18 + 8 * ii;
-        size_t seclen = sectors[ii].data.size();
+        size_t seclen = sectors[ii].storedSize();
         buffer[base] = sectors[ii].track;
         buffer[base + 0x01] = sectors[ii].side;
         buffer[base + 0x02] = sectors[ii].sectorId;
@@ -131,11 +147,12 @@ void DSKFile::Track::dump(vector<uint8_t>& buffer) {
         buffer[base + 0x05] = sectors[ii].fdcStatusReg2;
         buffer[base + 0x06] = (seclen & 0x00FF);
         buffer[base + 0x07] = (seclen & 0xFF00) >> 8;
-        buffer.insert(buffer.end(), sectors[ii].data.begin(), sectors[ii].data.end());
+        image.readData(sectors[ii], 0, seclen, data);
+        buffer.insert(buffer.end(), data.begin(), data.end());
     }
 }
 
-void DSKFile::Track::makeEmpty(size_t track, size_t side) {
+void DSKFile::Track::makeEmpty(size_t track, size_t side, vector<uint8_t>& arena) {
 
     trackNumber = track;
     sideNumber = side;
@@ -146,9 +163,53 @@ void DSKFile::Track::makeEmpty(size_t track, size_t side) {
     sectors.clear();
 
     Sector s(track, side, 0xFF, 0x01, 0x01, 0x01);
+    s.dataOffset = arena.size();
+    s.dataSize = s.sectorLength;
+    arena.insert(arena.end(), s.dataSize, 0xFF);
     sectors.push_back(s);
 }
 
+void DSKFile::Track::packCopies(Sector& sector, vector<uint8_t>& arena) {
+
+    size_t copySize = 0x80 << sector.sectorSize;
+    size_t copies = sector.dataSize / copySize;
+    uint8_t* data = &arena[sector.dataOffset];
+
+    // Find the bytes that are not the same in all copies. Close ranges
+    // are joined, because each range costs as much as a few bytes.
+    sector.weak.clear();
+    for (size_t ii = 0; ii < copySize; ++ii) {
+        bool same = true;
+        for (size_t cc = 1; same && cc < copies; ++cc) {
+            same = data[cc * copySize + ii] == data[ii];
+        }
+        if (!same) {
+            if (!sector.weak.empty() && ii - (sector.weak.back().offset
+                        + sector.weak.back().size) < sizeof(DSKWeak)) {
+                sector.weak.back().size = ii + 1 - sector.weak.back().offset;
+            } else {
+                sector.weak.push_back(DSKWeak{
+                        static_cast<uint16_t>(ii), static_cast<uint16_t>(1)});
+            }
+        }
+    }
+
+    // Keep the first copy, and then only the weak bytes of the others.
+    size_t packed = copySize;
+    for (size_t cc = 1; cc < copies; ++cc) {
+        for (DSKWeak const& weak : sector.weak) {
+            copy(&data[cc * copySize + weak.offset],
+                    &data[cc * copySize + weak.offset + weak.size], &data[packed]);
+            packed += weak.size;
+        }
+    }
+
+    // The sector is the last one in the arena.
+    sector.copies = copies;
+    sector.dataSize = packed;
+    arena.resize(sector.dataOffset + packed);
+}
+
 uint8_t const DSKFile::specide[16] = "DSK by SpecIDE";
 
 DSKFile::DSKFile() :
@@ -170,17 +231,27 @@ DSKFile::DSKFile() :
     validFile(false) {
 }
 
-void DSKFile::load(string const& fileName) {
-
-    ifstream ifs(fileName.c_str(), ios::binary);
-    if (ifs.good()) {
-        fileData.clear();
+DSKFile::DSKFile(DSKFile const& other) :
+    DSKFile() {
+
+    copy(&other.creator[0], &other.creator[16], &creator[0]);
+    numTracks = other.numTracks;
+    numSides = other.numSides;
+    trackSizeTable = other.trackSizeTable;
+    tracks = other.tracks;
+    arena = other.arena;
+    base = other.base;
+    fileName = other.fileName;
+    dirty = other.dirty;
+    reshaped = other.reshaped;
+    stdMagicOk = other.stdMagicOk;
+    extMagicOk = other.extMagicOk;
+    validFile = other.validFile;
+}
 
-        char c;
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
+void DSKFile::load(string const& fileName) {
 
+    if (fileData.open(fileName)) {
         // Disk Info Block must be at least 0x100 bytes long.
         // If the file is shorter, then it is not valid.
         if (fileData.size() < 0x100) {
@@ -200,15 +271,20 @@ void DSKFile::load(string const& fileName) {
         buildTrackSizeTable();
         if (validFile) {
             loadTracks();
+            this->fileName = fileName;
+            dirty = reshaped = false;
         }
     } else {
         cout << fileName << ": Not a DSK image file." << endl;
     }
+
+    // Sectors are copied to the arena.
+    fileData.close();
 }
 
 void DSKFile::readNameOfCreator() {
 
-    copy(&fileData[0x22], &fileData[0x30], creator);
+    copy(fileData.data() + 0x22, fileData.data() + 0x30, creator);
     creator[14] = creator[15] = '\0';
 }
 
@@ -249,21 +325,24 @@ void DSKFile::loadTracks() {
 
     size_t totalTracks = numTracks * numSides;
     tracks.clear();
+    arena.clear();
+    arena.reserve(fileData.size());
+    base.reset();
 
     size_t offset = 0x100;
     for (size_t tt = 0; tt < totalTracks; ++tt) {
         tracks.push_back(Track());
         tracks[tt].trackSize = trackSizeTable[tt];
 
-        if (trackSizeTable[tt]) {
-            tracks[tt].load(fileData, offset);
+        if (trackSizeTable[tt] && offset + 0x100 <= fileData.size()) {
+            tracks[tt].load(fileData, offset, arena);
         }
 
         offset += trackSizeTable[tt];
     }
 }
 
-void DSKFile::save(string const& fileName) {
+bool DSKFile::save(string const& fileName) {
 
     size_t totalTracks = numTracks * numSides;
     if (totalTracks > 208) {
@@ -282,14 +361,108 @@ void DSKFile::save(string const& fileName) {
     for (size_t ii = 0; ii < totalTracks; ++ii) {
         buffer[0x34 + ii] = ((tracks[ii].trackSize & 0xFF00) >> 8);
         if (tracks[ii].trackSize) {
-            tracks[ii].dump(buffer);
+            tracks[ii].dump(buffer, *this);
         }
     }
 
     ofstream ofs(fileName.c_str(), ios::binary);
     if (ofs.good()) {
-        for (size_t ii = 0; ii < buffer.size(); ++ii) {
-            ofs.put(buffer[ii]);
+        ofs.write(reinterpret_cast<char const*>(buffer.data()), buffer.size());
+    }
+    return ofs.good();
+}
+
+bool DSKFile::flush(bool full) {
+
+    if (fileName.empty() || !dirty) {
+        return true;
+    }
+
+    if (!reshaped && patch()) {
+        return true;
+    }
+
+    if (!full) {
+        return false;
+    }
+
+    // Write a new file, and replace the old one only when it is complete.
+    string temp = fileName + ".tmp";
+    if (!save(temp)) {
+        cout << "Error: Cannot write " << temp << endl;
+        return false;
+    }
+    if (rename(temp.c_str(), fileName.c_str())) {
+        // Some systems do not replace an existing file.
+        remove(fileName.c_str());
+        if (rename(temp.c_str(), fileName.c_str())) {
+            cout << "Error: Cannot replace " << fileName << endl;
+            return false;
+        }
+    }
+
+    locate();
+    dirty = reshaped = false;
+    cout << "Saved " << fileName << endl;
+    return true;
+}
+
+bool DSKFile::patch() {
+
+    // Sectors whose size changed, or that were not in the file, do not fit.
+    for (Track const& track : tracks) {
+        for (Track::Sector const& sector : track.sectors) {
+            if (sector.dirty && (track.fileOffset == SIZE_MAX
+                        || sector.fileOffset == SIZE_MAX
+                        || sector.fileSize != sector.storedSize())) {
+                return false;
+            }
+        }
+    }
+
+    fstream fs(fileName.c_str(), ios::in | ios::out | ios::binary);
+    if (!fs.good()) {
+        return false;
+    }
+
+    for (Track& track : tracks) {
+        for (size_t ii = 0; ii < track.sectors.size(); ++ii) {
+            Track::Sector& sector = track.sectors[ii];
+            if (sector.dirty) {
+                // Status registers are in the Sector Information List.
+                char status[2] = {
+                    static_cast<char>(sector.fdcStatusReg1),
+                    static_cast<char>(sector.fdcStatusReg2)
+                };
+                fs.seekp(track.fileOffset + 0x18 + 8 * ii + 4);
+                fs.write(status, 2);
+                DSKSpan data = sectorData(sector);
+                fs.seekp(sector.fileOffset);
+                fs.write(reinterpret_cast<char const*>(data.data), data.size);
+                sector.dirty = false;
+            }
+        }
+    }
+
+    dirty = false;
+    return fs.good();
+}
+
+void DSKFile::locate() {
+
+    // Same layout as save().
+    size_t offset = 0x100;
+    for (size_t ii = 0; ii < tracks.size() && ii < numTracks * numSides; ++ii) {
+        Track& track = tracks[ii];
+        if (track.trackSize) {
+            track.fileOffset = offset;
+            offset += 0x100;
+            for (size_t jj = 0; jj < track.numSectors && jj < track.sectors.size(); ++jj) {
+                track.sectors[jj].fileOffset = offset;
+                track.sectors[jj].fileSize = track.sectors[jj].storedSize();
+                track.sectors[jj].dirty = false;
+                offset += track.sectors[jj].fileSize;
+            }
         }
     }
 }
@@ -302,12 +475,124 @@ void DSKFile::makeEmpty() {
     extMagicOk = true;
     validFile = true;
     tracks.clear();
+    arena.clear();
+    base.reset();
 
     for (size_t tr = 0; tr < numTracks; ++tr) {
         for (size_t sc = 0; sc < numSides; ++sc) {
             tracks.push_back(Track());
-            tracks[numSides * sc + tr].makeEmpty(tr, sc);
+            tracks[numSides * sc + tr].makeEmpty(tr, sc, arena);
         }
     }
 }
+
+void DSKFile::share() {
+
+    vector<uint8_t> shared;
+    shared.reserve((base ? base->size() : 0) + arena.size());
+    for (Track& track : tracks) {
+        for (Track::Sector& sector : track.sectors) {
+            uint8_t const* data = (sector.shared ? base->data() : arena.data())
+                + sector.dataOffset;
+            size_t offset = shared.size();
+            shared.insert(shared.end(), data, data + sector.dataSize);
+            sector.dataOffset = offset;
+            sector.shared = true;
+        }
+    }
+    base = make_shared<vector<uint8_t> const>(std::move(shared));
+    arena.clear();
+    arena.shrink_to_fit();
+}
+
+void DSKFile::allocate(Track::Sector& sector, size_t size, uint8_t value) {
+
+    if (size > sector.dataSize || sector.shared) {
+        sector.dataOffset = arena.size();
+        sector.shared = false;
+        arena.resize(arena.size() + size);
+    }
+    sector.dataSize = size;
+    sector.copies = 1;
+    sector.weak.clear();
+    sector.dirty = dirty = true;
+    fill(arena.begin() + sector.dataOffset, arena.begin() + sector.dataOffset + size, value);
+}
+
+void DSKFile::compact() {
+
+    vector<uint8_t> compacted;
+    compacted.reserve(arena.size());
+    for (Track& track : tracks) {
+        for (Track::Sector& sector : track.sectors) {
+            if (sector.shared) {
+                continue;
+            }
+            size_t offset = compacted.size();
+            compacted.insert(compacted.end(), arena.begin() + sector.dataOffset,
+                    arena.begin() + sector.dataOffset + sector.dataSize);
+            sector.dataOffset = offset;
+        }
+    }
+    arena.swap(compacted);
+}
+
+void DSKFile::readData(Track::Sector const& sector, size_t offset, size_t size,
+        vector<uint8_t>& data) const {
+
+    uint8_t const* stored = (sector.shared ? base->data() : arena.data())
+        + sector.dataOffset;
+    size_t copySize = sector.copySize();
+    size_t weakSize = (sector.copies > 1)
+        ? (sector.dataSize - copySize) / (sector.copies - 1) : 0;
+    size_t last = min(offset + size, sector.storedSize());
+
+    data.clear();
+
+    // A sector with no data in the file reads as 0xFF.
+    if (!sector.dataSize) {
+        size_t length = sector.sectorLength
+            ? sector.sectorLength : (0x80u << (sector.sectorSize & 0x07));
+        if (offset < length) {
+            data.assign(min(size, length - offset), 0xFF);
+        }
+        return;
+    }
+    while (offset < last) {
+        size_t cc = offset / copySize;
+        size_t first = offset % copySize;
+        size_t end = min(copySize, first + last - offset);
+        size_t start = data.size();
+        data.insert(data.end(), stored + first, stored + end);
+
+        // The other copies differ from the first only in the weak bytes.
+        if (cc) {
+            uint8_t const* bytes = stored + copySize + (cc - 1) * weakSize;
+            for (DSKWeak const& weak : sector.weak) {
+                size_t from = max(first, static_cast<size_t>(weak.offset));
+                size_t to = min(end, static_cast<size_t>(weak.offset + weak.size));
+                if (from < to) {
+                    copy(bytes + from - weak.offset, bytes + to - weak.offset,
+                            &data[start + from - first]);
+                }
+                bytes += weak.size;
+            }
+        }
+        offset += end - first;
+    }
+}
+
+void DSKFile::store(Track::Sector& sector, uint8_t const* bytes, size_t size) {
+
+    if (size > sector.dataSize || sector.shared) {
+        sector.dataOffset = arena.size();
+        sector.shared = false;
+        arena.resize(arena.size() + size);
+    }
+    sector.dataSize = size;
+    sector.copies = 1;
+    sector.weak.clear();
+    sector.dirty = dirty = true;
+    copy(bytes, bytes + size, arena.begin() + sector.dataOffset);
+}
 // vim: et:sw=4:ts=4:
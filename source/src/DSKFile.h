@@ -16,16 +16,55 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "FileView.h"
+
 /** DSKFile.h
  *
  * DSK file format implementation.
  *
  * This class loads a DSK file.
+ *
+ * The data of all sectors is stored in a single arena, one sector after
+ * another. Tracks and sectors are a small index into it, so an image is
+ * copied or moved as a whole, and sectors are read and written in place.
+ *
+ * After share(), the sector data moves to a base arena that is never
+ * written, and that copies of the image share. Each copy keeps its written
+ * sectors in its own arena, so the same image can be inserted in several
+ * drives without duplicating its data.
+ *
+ * Weak sectors, stored in extended images as several copies of the data,
+ * keep only the first copy whole. The other copies keep only the ranges of
+ * bytes that differ from the first one, so a protected image takes about
+ * as much memory as a plain one. Writing a weak sector makes it a normal
+ * one, with a single copy.
+ *
+ * Written sectors are marked as dirty, and flush() writes only them back
+ * to the image file. If the layout of the image has changed, the file is
+ * rewritten instead.
  */
 
+/** A view of sector data in the arena. It is valid until the arena grows. */
+struct DSKSpan {
+
+    uint8_t const* data = nullptr;
+    size_t size = 0;
+
+    uint8_t const* begin() const { return data; }
+    uint8_t const* end() const { return data + size; }
+};
+
+/** A range of bytes that differ between the copies of a weak sector. */
+struct DSKWeak {
+
+    uint16_t offset;
+    uint16_t size;
+};
+
 class DSKFile {
 
     public:
@@ -43,11 +82,28 @@ class DSKFile {
                         uint_fast8_t fdcStatusReg2;
                         uint_fast16_t sectorLength;
 
-                        std::vector<uint8_t> data;
+                        size_t dataOffset = 0;  // Position in the arena.
+                        size_t dataSize = 0;    // Stored bytes.
+                        bool shared = false;    // Data is in the base arena.
+                        size_t fileOffset = SIZE_MAX;   // Position in the file.
+                        size_t fileSize = 0;    // Bytes in the file.
+                        bool dirty = false;     // Written since the last flush.
+                        uint_fast16_t copies = 1;   // Copies of a weak sector.
+                        std::vector<DSKWeak> weak;  // Bytes that vary.
 
                         Sector(uint_fast8_t track, uint_fast8_t side,
                                 uint_fast8_t id, uint_fast8_t size,
                                 uint_fast8_t status1, uint_fast8_t status2);
+
+                        /** Bytes in each copy of the data. */
+                        size_t copySize() const {
+                            return (copies > 1) ? (0x80 << sectorSize) : dataSize;
+                        }
+
+                        /** Bytes of all copies, as stored in the file. */
+                        size_t storedSize() const {
+                            return copies * copySize();
+                        }
                 };
 
                 Track();
@@ -60,18 +116,30 @@ class DSKFile {
                 uint_fast8_t gapLength;
                 uint_fast8_t fillerByte;
                 uint_fast16_t trackSize;
+                size_t fileOffset = SIZE_MAX;   // Track-Info position in the file.
 
                 bool magicOk;
 
                 std::vector<Sector> sectors;
 
-                bool load(std::vector<uint8_t> const& data, size_t offset);
-                void dump(std::vector<uint8_t>& data);
-                void makeEmpty(size_t track, size_t side);
+                bool load(FileView const& data, size_t offset,
+                        std::vector<uint8_t>& arena);
+                void dump(std::vector<uint8_t>& data, DSKFile const& image);
+                void makeEmpty(size_t track, size_t side,
+                        std::vector<uint8_t>& arena);
+                void packCopies(Sector& sector, std::vector<uint8_t>& arena);
         };
 
         DSKFile();
 
+        /**
+         * Copy the image, but not the file, which is only open while
+         * loading. A shared image is copied without its sector data.
+         */
+        DSKFile(DSKFile const& other);
+        DSKFile(DSKFile&& other) = default;
+        DSKFile& operator=(DSKFile&& other) = default;
+
         static uint8_t const specide[16];
 
         uint8_t stdMagic[34];
@@ -81,21 +149,88 @@ class DSKFile {
         uint_fast8_t numSides;
         std::vector<uint_fast16_t> trackSizeTable;
         std::vector<Track> tracks;
+        std::vector<uint8_t> arena;     // Sector data.
+        std::shared_ptr<std::vector<uint8_t> const> base;   // Shared sector data.
+
+        std::string fileName;   // Image file, if the image was loaded.
+        bool dirty = false;     // Some sector was written.
+        bool reshaped = false;  // Some track was formatted.
 
         bool stdMagicOk;
         bool extMagicOk;
         bool validFile;
 
-        std::vector<uint8_t> fileData;
+        FileView fileData;  // Only open while loading.
 
         void load(std::string const& fileName);
-        void save(std::string const& fileName);
+        bool save(std::string const& fileName);
         void readNameOfCreator();
         void readNumberOfTracks();
         void readNumberOfSides();
         void buildTrackSizeTable();
         void loadTracks();
         void makeEmpty();
+
+        /**
+         * Get the data of a sector. For weak sectors, this is the first copy.
+         */
+        DSKSpan sectorData(Track::Sector const& sector) const {
+            uint8_t const* data = sector.shared ? base->data() : arena.data();
+            return DSKSpan{data + sector.dataOffset, sector.copySize()};
+        }
+
+        /**
+         * Copy bytes of a sector, as they are stored in the file. For weak
+         * sectors, the copies follow one another. A sector with no data in
+         * the file reads as 0xFF.
+         *
+         * @param offset First byte to copy.
+         * @param size Bytes to copy, if there are so many.
+         * @param data Buffer that receives the bytes.
+         */
+        void readData(Track::Sector const& sector, size_t offset, size_t size,
+                std::vector<uint8_t>& data) const;
+
+        /**
+         * Move the sector data to a new base arena, to be shared by the
+         * copies of this image.
+         */
+        void share();
+
+        /**
+         * Give a sector new data, filled with a value. The data is placed
+         * like in store().
+         */
+        void allocate(Track::Sector& sector, size_t size, uint8_t value);
+
+        /**
+         * Replace the data of a sector. The data is written in place if
+         * it fits, or moved to the end of the arena if it does not. Shared
+         * data is never written; the sector gets a copy in the arena.
+         */
+        void store(Track::Sector& sector, uint8_t const* bytes, size_t size);
+
+        /**
+         * Drop the data that no sector uses, after a track is formatted.
+         * The base arena is not changed.
+         */
+        void compact();
+
+        /**
+         * Write the changes back to the image file.
+         *
+         * Dirty sectors are written in place. If the layout changed, the
+         * whole image is written to a temporary file that replaces the
+         * original, but only if a full write is allowed.
+         *
+         * @param full Allow rewriting the whole file.
+         * @return True if the file is up to date.
+         */
+        bool flush(bool full);
+
+    private:
+        bool patch();
+        void locate();
 };
 
 // vim: et:sw=4:ts=4:
@@ -31,44 +31,92 @@ void FD1793::clock() {
     // The Status Register indicates whether the completed command encountered
     // an error or was fault free.
 
-    if (commandNew) {
-        checkCommand();
+    // The disk spins while the head is loaded.
+    if (headLoaded) {
+        rotate();
     }
-    // First check for FORCE INTERRUPT command.
+
     switch (state) {
-        case FD1793State::FD1793_STATE_IDLE:
+        case FD1793State::IDLE:
+            if (indexEdge && indexInterrupt) {
+                intrq = true;
+            }
+            if (headLoaded && revolutions >= FD1793_UNLOAD_REVOLUTIONS) {
+                headLoaded = false;
+            }
+            if (!headLoaded && !indexInterrupt) {
+                sleeping = true;
+            }
+            break;
+
+        case FD1793State::DELAY:
+            if (!wait()) {
+                state = delayed;
+            }
+            break;
+
+        case FD1793State::STEP:
+            stepOp();
+            break;
+
+        case FD1793State::VERIFY:
+            verifyOp();
+            break;
+
+        case FD1793State::SEARCH:
+            searchOp();
+            break;
+
+        case FD1793State::INDEX:
+            indexOp();
+            break;
+
+        case FD1793State::READ:
+            readOp();
+            break;
+
+        case FD1793State::WRITE:
+            writeOp();
             break;
     }
 }
 
 void FD1793::reset() {
 
-    state = FD1793_STATE_IDLE;
+    state = FD1793State::IDLE;
+    command = FD1793Command::INVALID;
+    commandReg = 0x03;
+    sectorReg = 0x01;
+    statusReg = 0x00;
+    typeOne = true;
+    intrq = false;
+    drq = false;
+    indexInterrupt = false;
+    headLoaded = false;
+    timer = 0;
+    sectorData = nullptr;
+    sleeping = false;
 }
 
 uint_fast8_t FD1793::read(uint_fast8_t address) {
 
-    static uint_fast8_t retval = 0x00;
-
     switch (address) {
         case 0x00:  // Status register
-            retval = statusReg;
-            break;
+            intrq = false;
+            return status();
         case 0x01:  // Track register
-            retval = trackReg;
-            break;
+            return trackReg;
         case 0x02:  // Sector register
-            retval = sectorReg;
-            break;
+            return sectorReg;
         case 0x03:  // Data register
-            retval = dataReg;
-            break;
+            drq = false;
+            return dataReg;
         case 0x07:  // System register (Not an FD1793 register, though)
-            retval = systemReg;
-            break;
+            // The BetaDisk returns INTRQ and DRQ.
+            return (intrq ? 0x80 : 0x00) | (drq ? 0x40 : 0x00) | 0x3F;
+        default:
+            return 0xFF;
     }
-
-    return retval;
 }
 
 void FD1793::write(uint_fast8_t address, uint_fast8_t value) {
@@ -76,7 +124,8 @@ void FD1793::write(uint_fast8_t address, uint_fast8_t value) {
     switch (address) {
         case 0x00:  // Command register
             commandReg = value;
-            commandNew = true;
+            intrq = false;
+            checkCommand();
             break;
         case 0x01:  // Track register
             trackReg = value;
@@ -86,20 +135,36 @@ void FD1793::write(uint_fast8_t address, uint_fast8_t value) {
             break;
         case 0x03:  // Data register
             dataReg = value;
+            drq = false;
             break;
         case 0x07:  // System register
+            // Bit 2 is the Master Reset. When it is released, the FD1793
+            // executes a Restore command.
+            if (!(value & 0x04)) {
+                reset();
+            } else if (!(systemReg & 0x04)) {
+                systemReg = value;
+                commandReg = 0x03;
+                checkCommand();
+            }
             systemReg = value;
             break;
+        default:
+            break;
     }
 }
 
 void FD1793::checkCommand() {
 
+    // Commands come from the CPU or from a Master Reset, and need the clock.
+    sleeping = false;
+
     if ((commandReg & 0xF0) == 0xD0) {
         // Type IV command: Force Interrupt.
-        command = FD1793Command::INTERRUPT;
+        command = FD1793Command::FORCE_INTERRUPT;
         prepareType4();
     } else if (!(statusReg & STATUS_BUSY)) {
+        indexInterrupt = false;
         switch (commandReg & 0xF0) {
             // Type I commands: Restore, Seek, Step, Step In, Step Out.
             case 0x00:
@@ -157,33 +222,556 @@ void FD1793::checkCommand() {
     }
 }
 
-void prepareType1() {
+void FD1793::prepareType1() {
 
     updateFlag = commandReg & 0x10;
     headLoadFlag = commandReg & 0x08;
     verifyFlag = commandReg & 0x04;
     stepRate = commandReg & 0x03;
+
+    startType1();
 }
 
-void prepareType2() {
+void FD1793::prepareType2() {
 
     multipleRecordFlag = commandReg & 0x10;
-    sideSelectFlag = commandReg & 0x08;
+    sideFlag = (commandReg & 0x08) >> 3;
     sideCompareFlag = commandReg & 0x02;
 
-    prepareType3();
+    delayFlag = commandReg & 0x04;
+
+    startType2();
 }
 
-void prepareType3() {
+void FD1793::prepareType3() {
 
+    multipleRecordFlag = false;
     delayFlag = commandReg & 0x04;
+
+    startType3();
+}
+
+void FD1793::prepareType4() {
+
+    indexInterrupt = commandReg & 0x04;
+
+    // The command in progress is terminated. If there is none, the status
+    // register shows Type I bits again.
+    if (state == FD1793State::IDLE) {
+        typeOne = true;
+        statusReg = 0x00;
+    }
+    statusReg &= ~STATUS_BUSY;
+    state = FD1793State::IDLE;
+    drq = false;
+    sectorData = nullptr;
+    revolutions = 0;
+
+    // Immediate interrupt.
+    if (commandReg & 0x08) {
+        intrq = true;
+    }
+}
+
+void FD1793::startType1() {
+
+    typeOne = true;
+    statusReg = STATUS_BUSY;
+    headLoaded = headLoadFlag || verifyFlag;
+    revolutions = 0;
+    timer = 0;
+
+    switch (command) {
+        case FD1793Command::RESTORE:
+            steps = 255;
+            break;
+        case FD1793Command::STEP_IN:
+            stepIn = true;
+            steps = 1;
+            break;
+        case FD1793Command::STEP_OUT:
+            stepIn = false;
+            steps = 1;
+            break;
+        case FD1793Command::STEP:
+            steps = 1;
+            break;
+        default:
+            break;
+    }
+    state = FD1793State::STEP;
+}
+
+void FD1793::startType2() {
+
+    typeOne = false;
+    statusReg = STATUS_BUSY;
+
+    if (!current().disk) {
+        finish(STATUS_NOTREADY);
+        return;
+    }
+
+    headLoaded = true;
+    revolutions = 0;
+
+    if (command == FD1793Command::WRITE_SECTOR && current().writeprot) {
+        finish(STATUS_WRITEPROT);
+        return;
+    }
+
+    timer = delayFlag ? FD1793_SETTLE : 0;
+    delayed = FD1793State::SEARCH;
+    state = FD1793State::DELAY;
+}
+
+void FD1793::startType3() {
+
+    typeOne = false;
+    statusReg = STATUS_BUSY;
+
+    if (!current().disk) {
+        finish(STATUS_NOTREADY);
+        return;
+    }
+
+    headLoaded = true;
+    revolutions = 0;
+
+    if (command == FD1793Command::WRITE_TRACK && current().writeprot) {
+        finish(STATUS_WRITEPROT);
+        return;
+    }
+
+    // Write Track requests the first byte before the index pulse.
+    drq = (command == FD1793Command::WRITE_TRACK);
+
+    timer = delayFlag ? FD1793_SETTLE : 0;
+    delayed = (command == FD1793Command::READ_ADDRESS) ?
+        FD1793State::SEARCH : FD1793State::INDEX;
+    state = FD1793State::DELAY;
+}
+
+uint_fast8_t FD1793::status() {
+
+    uint_fast8_t value = statusReg;
+    if (!current().disk) {
+        value |= STATUS_NOTREADY;
+    }
+
+    if (typeOne) {
+        value &= STATUS_BUSY | STATUS_CRCERROR | STATUS_SEEKERROR | STATUS_NOTREADY;
+        if (headLoaded) {
+            value |= STATUS_HEADLOADED;
+            if (current().disk && rotation < FD1793_INDEX_PULSE) {
+                value |= STATUS_INDEX;
+            }
+        }
+        if (current().track0()) {
+            value |= STATUS_TRACK0;
+        }
+        if (current().writeprot) {
+            value |= STATUS_WRITEPROT;
+        }
+    } else {
+        value = (value & ~STATUS_DRQ) | (drq ? STATUS_DRQ : 0x00);
+    }
+    return value;
+}
+
+bool FD1793::wait() {
+
+    if (fastMode) {
+        timer = 0;
+    }
+
+    if (timer) {
+        --timer;
+        return true;
+    }
+    return false;
+}
+
+void FD1793::rotate() {
+
+    indexEdge = false;
+    if (++rotation == FD1793_REVOLUTION) {
+        rotation = 0;
+        ++revolutions;
+        indexEdge = true;
+    }
+}
+
+bool FD1793::idPassing(uint_fast8_t& id) {
+
+    // Sector IDs pass under the head at fixed positions.
+    if (rotation < FD1793_ID_OFFSET
+            || (rotation - FD1793_ID_OFFSET) % FD1793_SECTOR_SLOT) {
+        return false;
+    }
+
+    size_t slot = (rotation - FD1793_ID_OFFSET) / FD1793_SECTOR_SLOT;
+    if (slot >= TRD_SECTORS) {
+        return false;
+    }
+
+    // An unformatted track has no IDs.
+    id = TRD_INTERLEAVE[slot];
+    return current().sector(side(), id) != nullptr;
+}
+
+void FD1793::finish(uint_fast8_t status) {
+
+    statusReg = (statusReg & ~(STATUS_BUSY | STATUS_DRQ)) | status;
+    state = FD1793State::IDLE;
+    drq = false;
+    intrq = true;
+    revolutions = 0;
+    sectorData = nullptr;
+}
+
+void FD1793::step() {
+
+    if (stepIn) {
+        current().stepIn();
+    } else {
+        current().stepOut();
+    }
+    timer = FD1793_STEP_RATE[stepRate];
+}
+
+void FD1793::endType1() {
+
+    if (verifyFlag) {
+        revolutions = 0;
+        timer = FD1793_SETTLE;
+        state = FD1793State::VERIFY;
+    } else {
+        finish(0x00);
+    }
+}
+
+void FD1793::stepOp() {
+
+    if (wait()) {
+        return;
+    }
+
+    switch (command) {
+        case FD1793Command::RESTORE:
+            // Step out until the track 0 signal is found.
+            if (current().track0()) {
+                trackReg = 0;
+                endType1();
+            } else if (!steps--) {
+                finish(STATUS_SEEKERROR);
+            } else {
+                stepIn = false;
+                step();
+            }
+            break;
+
+        case FD1793Command::SEEK:
+            // The destination track is in the data register.
+            if (trackReg == dataReg) {
+                endType1();
+            } else {
+                stepIn = (dataReg > trackReg);
+                trackReg += stepIn ? 1 : -1;
+                step();
+            }
+            break;
+
+        default:
+            if (steps) {
+                --steps;
+                if (updateFlag) {
+                    trackReg += stepIn ? 1 : -1;
+                }
+                step();
+            } else {
+                endType1();
+            }
+            break;
+    }
+}
+
+void FD1793::verifyOp() {
+
+    if (wait()) {
+        return;
+    }
+
+    if (!current().disk) {
+        finish(STATUS_SEEKERROR);
+        return;
+    }
+
+    // Find an ID with the track number of the track register.
+    uint_fast8_t id;
+    if (fastMode) {
+        bool found = current().cylinder == trackReg && current().sector(side(), 1);
+        finish(found ? 0x00 : STATUS_SEEKERROR);
+    } else if (idPassing(id)) {
+        if (current().cylinder == trackReg) {
+            finish(0x00);
+        }
+    } else if (revolutions >= FD1793_SEARCH_REVOLUTIONS) {
+        finish(STATUS_SEEKERROR);
+    }
+}
+
+void FD1793::searchOp() {
+
+    uint_fast8_t id;
+    if (fastMode) {
+        // The next ID, or the requested sector, is found at once.
+        id = (command == FD1793Command::READ_ADDRESS)
+            ? TRD_INTERLEAVE[(rotation / FD1793_SECTOR_SLOT) % TRD_SECTORS]
+            : sectorReg;
+        rotation = (rotation + FD1793_SECTOR_SLOT) % FD1793_REVOLUTION;
+        if (!current().sector(side(), id)) {
+            finish(STATUS_RNF);
+            return;
+        }
+    } else if (!idPassing(id)) {
+        if (revolutions >= FD1793_SEARCH_REVOLUTIONS) {
+            finish(STATUS_RNF);
+        }
+        return;
+    }
+
+    if (command == FD1793Command::READ_ADDRESS) {
+        readAddress(id);
+        return;
+    }
+
+    // The ID must match the track register and the sector register, and
+    // the side, if it is compared.
+    if (id != sectorReg || current().cylinder != trackReg
+            || (sideCompareFlag && sideFlag)) {
+        if (fastMode) {
+            finish(STATUS_RNF);
+        }
+        return;
+    }
+
+    uint8_t* data = current().sector(side(), id);
+    bufferIndex = 0;
+    bufferSize = TRD_SECTOR_SIZE;
+    timer = FD1793_DATA_GAP * byteTime();
+    if (command == FD1793Command::READ_SECTOR) {
+        buffer.assign(data, data + TRD_SECTOR_SIZE);
+        state = FD1793State::READ;
+    } else {
+        sectorData = data;
+        buffer.assign(TRD_SECTOR_SIZE, 0x00);
+        drq = true;
+        state = FD1793State::WRITE;
+    }
+}
+
+void FD1793::indexOp() {
+
+    if (!fastMode && !indexEdge) {
+        return;
+    }
+
+    bufferIndex = 0;
+    bufferSize = FD1793_TRACK_BYTES * FD1793_BYTE_MFM / byteTime();
+    timer = 0;
+    if (command == FD1793Command::READ_TRACK) {
+        buildTrack();
+        state = FD1793State::READ;
+    } else {
+        buffer.assign(bufferSize, 0x4E);
+        state = FD1793State::WRITE;
+    }
+}
+
+void FD1793::readOp() {
+
+    if (wait()) {
+        return;
+    }
+
+    // In fast mode, the next byte is ready as soon as the CPU reads this one.
+    if (fastMode && drq) {
+        return;
+    }
+
+    if (drq) {
+        statusReg |= STATUS_LOSTDATA;
+    }
+
+    if (bufferIndex < bufferSize) {
+        dataReg = buffer[bufferIndex++];
+        drq = true;
+        timer = byteTime();
+    } else {
+        drq = false;
+        if (command == FD1793Command::READ_SECTOR && multipleRecordFlag) {
+            ++sectorReg;
+            revolutions = 0;
+            state = FD1793State::SEARCH;
+        } else {
+            finish(0x00);
+        }
+    }
+}
+
+void FD1793::writeOp() {
+
+    if (wait()) {
+        return;
+    }
+
+    // In fast mode, the next byte is requested as soon as the CPU writes
+    // this one.
+    if (fastMode && drq) {
+        return;
+    }
+
+    if (bufferIndex < bufferSize) {
+        // If the CPU did not write the byte in time, a zero is written.
+        if (drq) {
+            statusReg |= STATUS_LOSTDATA;
+            dataReg = 0x00;
+        }
+        buffer[bufferIndex++] = dataReg;
+        drq = (bufferIndex < bufferSize);
+        timer = byteTime();
+    } else {
+        if (command == FD1793Command::WRITE_TRACK) {
+            formatTrack();
+            finish(0x00);
+        } else {
+            copy(buffer.begin(), buffer.end(), sectorData);
+            if (multipleRecordFlag) {
+                ++sectorReg;
+                revolutions = 0;
+                state = FD1793State::SEARCH;
+            } else {
+                finish(0x00);
+            }
+        }
+    }
 }
 
-void prepareType4() {
+void FD1793::readAddress(uint_fast8_t id) {
+
+    // Track, side, sector, length and CRC. The track goes to the sector
+    // register.
+    uint_fast8_t cylinder = static_cast<uint_fast8_t>(current().cylinder);
+    uint16_t value = 0xFFFF;
+    for (uint8_t byte : {0xA1, 0xA1, 0xA1, 0xFE}) {
+        value = crc(value, byte);
+    }
+    buffer = {cylinder, 0x00, id, 0x01};
+    for (uint8_t byte : buffer) {
+        value = crc(value, byte);
+    }
+    buffer.push_back(value >> 8);
+    buffer.push_back(value & 0xFF);
 
-    notReadyToReady = commandReg & 0x01;
-    readyToNotReady = commandReg & 0x02;
-    indexPulseFlag = commandReg & 0x04;
-    immediateInterrupt = commandReg & 0x08;
+    sectorReg = cylinder;
+    bufferIndex = 0;
+    bufferSize = buffer.size();
+    timer = 0;
+    state = FD1793State::READ;
 }
+
+void FD1793::buildTrack() {
+
+    // Rebuild the track, as TR-DOS formats it.
+    buffer.clear();
+    auto put = [&](size_t count, uint8_t byte) {
+        buffer.insert(buffer.end(), count, byte);
+    };
+    auto field = [&](uint8_t const* data, size_t size) {
+        uint16_t value = 0xFFFF;
+        for (size_t ii = 0; ii < 3; ++ii) {
+            value = crc(value, 0xA1);
+        }
+        for (size_t ii = 0; ii < size; ++ii) {
+            value = crc(value, data[ii]);
+        }
+        put(3, 0xA1);
+        buffer.insert(buffer.end(), data, data + size);
+        buffer.push_back(value >> 8);
+        buffer.push_back(value & 0xFF);
+    };
+
+    put(80, 0x4E);
+    put(12, 0x00);
+    put(3, 0xC2);
+    put(1, 0xFC);
+    put(50, 0x4E);
+
+    uint8_t block[TRD_SECTOR_SIZE + 1];
+    for (size_t ii = 0; ii < TRD_SECTORS; ++ii) {
+        uint_fast8_t id = TRD_INTERLEAVE[ii];
+        uint8_t* data = current().sector(side(), id);
+        if (!data) {
+            continue;
+        }
+
+        uint8_t idField[5] = {
+            0xFE, static_cast<uint8_t>(current().cylinder), 0x00, id, 0x01
+        };
+        put(12, 0x00);
+        field(idField, 5);
+        put(22, 0x4E);
+
+        block[0] = 0xFB;
+        copy(data, data + TRD_SECTOR_SIZE, &block[1]);
+        put(12, 0x00);
+        field(block, TRD_SECTOR_SIZE + 1);
+        put(54, 0x4E);
+    }
+
+    buffer.resize(bufferSize, 0x4E);
+}
+
+void FD1793::formatTrack() {
+
+    // In the data written, F5 is a sync byte (A1), F6 is a C2 byte, and
+    // F7 writes the CRC. Only the data of the sectors that exist in a TRD
+    // image are kept.
+    bool sync = false;
+    int id = -1;
+    uint_fast8_t size = 0;
+    for (size_t ii = 0; ii < bufferIndex; ++ii) {
+        uint8_t byte = buffer[ii];
+        if (byte == 0xF5) {
+            sync = true;
+            continue;
+        }
+
+        if (sync && byte == 0xFE && ii + 4 < bufferIndex) {
+            id = buffer[ii + 3];
+            size = buffer[ii + 4] & 0x03;
+            ii += 4;
+        } else if (sync && (byte == 0xFB || byte == 0xF8) && id >= 0) {
+            size_t length = 0x80 << size;
+            uint8_t* data = current().sector(side(), static_cast<uint_fast8_t>(id));
+            if (data && length == TRD_SECTOR_SIZE && ii + length < bufferIndex) {
+                copy(&buffer[ii + 1], &buffer[ii + 1 + length], data);
+            }
+            ii += length;
+            id = -1;
+        }
+        sync = false;
+    }
+}
+
+uint16_t FD1793::crc(uint16_t value, uint8_t byte) {
+
+    value ^= byte << 8;
+    for (size_t ii = 0; ii < 8; ++ii) {
+        value = (value & 0x8000) ? (value << 1) ^ 0x1021 : (value << 1);
+    }
+    return value;
+}
+
 // vim: et:sw=4:ts=4
@@ -19,32 +19,33 @@
  *
  * WD1793 implementation.
  *
- * This is the controller used in BetaDisk interface.
+ * This is the controller used in BetaDisk interface. It is clocked at
+ * 1MHz, so a clock is a microsecond.
+ *
+ * - The disk rotates at 300rpm, and data is transferred at 250kbps (MFM),
+ *   so each byte takes 32 clocks. The CPU must read or write the data
+ *   register in time, or the controller reports lost data.
+ * - The drive motor is on while the head is loaded. The head unloads after
+ *   15 revolutions without commands, and then the FD1793 needs no clock.
+ * - TRD images only hold the sector data, so the sector IDs are rebuilt:
+ *   16 sectors of 256 bytes, with TR-DOS interleave, and side number 0 on
+ *   both sides, as TR-DOS formats them.
  */
 
 #include <cstdint>
+#include <vector>
 
-enum class FD1793State {
-    FD1793_STATE_IDLE,
-    FD1793_STATE_COMMAND,
-    FD1793_STATE_EXECUTION,
-    FD1793_STATE_RECEIVE,
-    FD1793_STATE_TRANSMIT,
-    FD1793_STATE_RESULT
-};
-
-enum class FD1793Mode {
-    FD1793_MODE_NONE,
-    FD1793_MODE_READ,
-    FD1793_MODE_WRITE
-};
+#include "TRDosDrive.h"
 
-enum class FD1793Access {
-    FD1793_ACCESS_LOAD,
-    FD1793_ACCESS_SEEK,
-    FD1793_ACCESS_DATA,
-    FD1793_ACCESS_UNLOAD,
-    FD1793_ACCESS_NONE
+enum class FD1793State {
+    IDLE,       // Waiting for a command.
+    DELAY,      // Waiting for the head to settle.
+    STEP,       // Stepping the head. (Type I)
+    VERIFY,     // Looking for an ID with the right track. (Type I)
+    SEARCH,     // Looking for the ID of a sector. (Type II, Read Address)
+    INDEX,      // Waiting for the index pulse. (Read Track, Write Track)
+    READ,       // Sending bytes to the CPU.
+    WRITE       // Receiving bytes from the CPU.
 };
 
 enum class FD1793Command {
@@ -97,40 +98,72 @@ uint8_t constexpr STATUS_WRITEPROT = 1 << 6;
 /** Status Reg b7 - NOT READY (All types). */
 uint8_t constexpr STATUS_NOTREADY = 1 << 7;
 
-uint32_t constexpr DELAY_1ms = 875;     // Clocking at 1.000MHz
-uint32_t constexpr SERVICE_MFM = 46;
-uint32_t constexpr SERVICE_FM = 91;
-uint32_t constexpr BYTE_DELAY = 100;
-
-uint_fast32_t MAX_TRDOS_DRIVES = 4;
+/** One revolution, at 300rpm. */
+uint32_t constexpr FD1793_REVOLUTION = 200000;
+/** Length of the index pulse. */
+uint32_t constexpr FD1793_INDEX_PULSE = 4000;
+/** Time between sector IDs. */
+uint32_t constexpr FD1793_SECTOR_SLOT = FD1793_REVOLUTION / TRD_SECTORS;
+/** Position of the first sector ID, after the index pulse. */
+uint32_t constexpr FD1793_ID_OFFSET = 4672;
+/** Bytes in a MFM track. */
+size_t constexpr FD1793_TRACK_BYTES = 6250;
+/** Time per byte, in MFM and FM. */
+uint32_t constexpr FD1793_BYTE_MFM = 32;
+uint32_t constexpr FD1793_BYTE_FM = 64;
+/** Bytes from the end of an ID to the data of the sector. */
+uint32_t constexpr FD1793_DATA_GAP = 43;
+/** Head settling time (E flag, and verify). */
+uint32_t constexpr FD1793_SETTLE = 30000;
+/** Step rates. */
+uint32_t constexpr FD1793_STEP_RATE[4] = {6000, 12000, 20000, 30000};
+/** Revolutions without an ID before Record Not Found. */
+uint32_t constexpr FD1793_SEARCH_REVOLUTIONS = 5;
+/** Revolutions without a command before the head unloads. */
+uint32_t constexpr FD1793_UNLOAD_REVOLUTIONS = 15;
+
+uint32_t constexpr MAX_TRDOS_DRIVES = 4;
 
 class FD1793 {
 
     public:
         /** Track number of the current read/write head position. */
-        uint_fast8_t trackReg;
+        uint_fast8_t trackReg = 0x00;
         /** Address of the desired sector position. */
-        uint_fast8_t sectorReg;
+        uint_fast8_t sectorReg = 0x01;
         /** Device status information. */
-        uint_fast8_t statusReg;
+        uint_fast8_t statusReg = 0x00;
         /** Command presently being executed. */
-        uint_fast8_t commandReg;
-        uint_fast8_t systemReg;
-        uint_fast8_t dataBuffer[65536];
-
-        bool commandNew = false;
-
-        FD1793State state = FD1793State::FD1793_STATE_IDLE;
-        FD1793Mode mode;
-        FD1793Access stage;
+        uint_fast8_t commandReg = 0x00;
+        /** Data byte to be read or written. */
+        uint_fast8_t dataReg = 0x00;
+        /** BetaDisk system register: drive, side, density. */
+        uint_fast8_t systemReg = 0x00;
+
+        /** Interrupt request output. */
+        bool intrq = false;
+        /** Data request output. */
+        bool drq = false;
+
+        /**
+         * Fast mode. Head loads, steps and sector searches complete at
+         * once, and data bytes are transferred as fast as the CPU reads
+         * or writes them, without lost data.
+         */
+        bool fastMode = false;
+        /**
+         * Nothing to do until the CPU writes a command. The FD1793 is idle
+         * and the head is unloaded, so it needs no clock.
+         */
+        bool sleeping = false;
+
+        FD1793State state = FD1793State::IDLE;
         FD1793Command command = FD1793Command::INVALID;
 
         TRDosDrive drive[MAX_TRDOS_DRIVES];
-        uint_fast8_t presCylNum[MAX_TRDOS_DRIVES];
 
         FD1793() :
-            drive{TRDosDrive(true), TRDosDrive(false), TRDosDrive(false), TRDosDrive(false)},
-            presCylNum{0, 0, 0, 0}
+            drive{TRDosDrive(true), TRDosDrive(true), TRDosDrive(false), TRDosDrive(false)}
         {}
 
         void clock();
@@ -145,6 +178,66 @@ class FD1793 {
         void prepareType2();
         void prepareType3();
         void prepareType4();
+
+    private:
+        // Type I flags.
+        bool updateFlag = false;
+        bool headLoadFlag = false;
+        bool verifyFlag = false;
+        uint_fast8_t stepRate = 0;
+        // Type II and III flags.
+        bool multipleRecordFlag = false;
+        bool sideCompareFlag = false;
+        uint_fast8_t sideFlag = 0;
+        bool delayFlag = false;
+        // Type IV flags.
+        bool indexInterrupt = false;
+
+        bool typeOne = true;        // Status register shows Type I bits.
+        bool stepIn = true;         // Last step direction.
+        bool headLoaded = false;    // Head is loaded, and the disk spins.
+        FD1793State delayed = FD1793State::IDLE;   // State after DELAY.
+        size_t steps = 0;           // Steps left.
+
+        uint32_t timer = 0;         // Clocks to wait.
+        uint32_t rotation = 0;      // Position in the revolution.
+        uint32_t revolutions = 0;   // Index pulses since the last command.
+        bool indexEdge = false;     // An index pulse started in this clock.
+
+        std::vector<uint8_t> buffer;    // Bytes of the current transfer.
+        size_t bufferIndex = 0;
+        size_t bufferSize = 0;
+        uint8_t* sectorData = nullptr;  // Sector being written.
+
+        TRDosDrive& current() { return drive[systemReg & 0x03]; }
+        size_t side() const { return (systemReg & 0x10) ? 0 : 1; }
+        uint32_t byteTime() const {
+            return (systemReg & 0x40) ? FD1793_BYTE_FM : FD1793_BYTE_MFM;
+        }
+
+        bool wait();
+        void rotate();
+        bool idPassing(uint_fast8_t& id);
+        void finish(uint_fast8_t status);
+        uint_fast8_t status();
+        void startType1();
+        void startType2();
+        void startType3();
+
+        void step();
+        void endType1();
+        void stepOp();
+        void verifyOp();
+        void searchOp();
+        void indexOp();
+        void readOp();
+        void writeOp();
+
+        void readAddress(uint_fast8_t id);
+        void buildTrack();
+        void formatTrack();
+
+        static uint16_t crc(uint16_t value, uint8_t byte);
 };
 
 // vim: et:sw=4:ts=4
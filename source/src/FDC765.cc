@@ -15,6 +15,8 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <set>
+#include <string>
 
 #include "FDC765.h"
 #include "SpecIde.h"
@@ -31,6 +33,11 @@ void FDC765::clock() {
             statusReg = SREG_RQM;
             if (inputByteReady) {
                 checkCommand();
+            } else if (!(loaded && unload)) {
+                // The head is unloaded. Write the sectors that changed,
+                // and leave the files that need a rewrite for the end.
+                flush(false);
+                sleeping = true;
             }
             break;
 
@@ -56,6 +63,12 @@ void FDC765::clock() {
             mode = FDC765Mode::WRITE;
             statusReg = SREG_EXM | SREG_CB;
             execute();
+
+            // Run the command until it needs the CPU, or it finishes.
+            for (size_t ii = 1; fastMode && ii < FAST_STEPS
+                    && state == FDC765State::EXECUTION; ++ii) {
+                execute();
+            }
             break;
 
         case FDC765State::RECEIVE:
@@ -74,7 +87,8 @@ void FDC765::clock() {
             }
 
             // Signal Over Run if FDC765 is not serviced quickly enough.
-            if (transfer && --serviceTimer == 0) {
+            // In fast mode the drive waits for the CPU.
+            if (transfer && !fastMode && --serviceTimer == 0) {
                 transfer = false;
                 sReg[1] |= 0x10;    // OR
                 sReg[0] |= 0x40;    // AT
@@ -100,7 +114,8 @@ void FDC765::clock() {
             }
 
             // Signal Over Run if FDC765 is not serviced quickly enough.
-            if (transfer && --serviceTimer == 0) {
+            // In fast mode the drive waits for the CPU.
+            if (transfer && !fastMode && --serviceTimer == 0) {
                 transfer = false;
                 sReg[1] |= 0x10;    // OR
                 sReg[0] |= 0x40;    // AT
@@ -512,9 +527,8 @@ void FDC765::formatCmd() {
                 uint_fast8_t fmtHead = dataBuffer[4 * currSector + 1];
                 uint_fast8_t fmtSector = dataBuffer[4 * currSector + 2];
                 uint_fast8_t fmtSize = dataBuffer[4 * currSector + 3];
-                drive[cmdDrive()].buffer.assign(0x80 << fmtSize, cmdBuffer[5]);
                 drive[cmdDrive()].formatSector(cmdHead(),
-                        fmtTrack, fmtHead, fmtSector, fmtSize);
+                        fmtTrack, fmtHead, fmtSector, fmtSize, cmdBuffer[5]);
                 drive[cmdDrive()].nextSector();
                 ++currSector;
             } else {
@@ -645,18 +659,20 @@ bool FDC765::readRegularDataOp() {
         sReg[1] |= 0x04;    // xxxxx1xx - ND
     }
 
-    size_t finish = min(offset + outlen, drive[cmdDrive()].buffer.size());
-    vector<uint8_t> buf(&drive[cmdDrive()].buffer[offset],
-            &drive[cmdDrive()].buffer[finish]);
+    vector<uint8_t> buf;
+    drive[cmdDrive()].readData(offset, outlen, buf);
 
     // Complete length
     buf.resize(outlen, drive[cmdDrive()].filler);
 
     // Detect Speedlock protection:
     // CRC error on track 00, sector 02, which is 512 bytes long.
+    // Images with weak sectors already give a different copy each time.
     if (((sReg[2] & 0x20) == 0x20) && cmdBuffer[2] == 0x00
             && cmdBuffer[4] == 0x02 && cmdBuffer[5] == 0x02) {
-        randomizeSector(buf);
+        if (actlen <= outlen) {
+            randomizeSector(buf);
+        }
         sReg[0] |= 0x40;    // 01000HUU - AT
         error = true;
     }
@@ -700,18 +716,20 @@ bool FDC765::readDeletedDataOp() {
         sReg[1] |= 0x04;    // xxxxx1xx - ND
     }
 
-    size_t finish = min(offset + outlen, drive[cmdDrive()].buffer.size());
-    vector<uint8_t> buf(&drive[cmdDrive()].buffer[offset],
-            &drive[cmdDrive()].buffer[finish]);
+    vector<uint8_t> buf;
+    drive[cmdDrive()].readData(offset, outlen, buf);
 
     // Complete length
     buf.resize(outlen, drive[cmdDrive()].filler);
 
     // Detect Speedlock protection:
     // CRC error on track 00, sector 02, which is 512 bytes long.
+    // Images with weak sectors already give a different copy each time.
     if (((sReg[2] & 0x20) == 0x20) && cmdBuffer[2] == 0x00
             && cmdBuffer[4] == 0x02 && cmdBuffer[5] == 0x02) {
-        randomizeSector(buf);
+        if (actlen <= outlen) {
+            randomizeSector(buf);
+        }
         sReg[0] |= 0x40;    // 01000HUU - AT
     }
 
@@ -857,6 +875,11 @@ bool FDC765::readIdOp() {
 
 bool FDC765::headLoadOp() {
 
+    if (fastMode) {
+        loaded = true;
+        return loaded;
+    }
+
     --loadTimer;
     if (!loadTimer) {
         loadTimer = headLoadTime;
@@ -972,12 +995,13 @@ bool FDC765::readTrackOp() {
         outlen = actlen;
     }
 
-    vector<uint8_t> buf(
-            &drive[cmdDrive()].buffer[0], &drive[cmdDrive()].buffer[outlen]);
+    vector<uint8_t> buf;
+    drive[cmdDrive()].readData(0, outlen, buf);
 
     // Detect Speedlock protection:
     // CRC error on track 00, sector 02, which is 512 bytes long.
-    if (((sReg[2] & 0x20) == 0x20) && cmdBuffer[2] == 0x00
+    // Images with weak sectors already give a different copy each time.
+    if (((sReg[2] & 0x20) == 0x20) && actlen <= outlen && cmdBuffer[2] == 0x00
             && cmdBuffer[4] == 0x02 && cmdBuffer[5] == 0x02) {
         randomizeSector(buf);
     }
@@ -1065,7 +1089,8 @@ void FDC765::writeCmd() {
 
         case FDC765Access::DATA:
             {
-                vector<uint8_t> buffer = drive[cmdDrive()].buffer;
+                vector<uint8_t> buffer;
+                drive[cmdDrive()].readData(0, dataBytes, buffer);
                 buffer.resize(dataBytes, 0);
 
                 // If we're doing a multisector transfer, we copy this sector
@@ -1079,10 +1104,9 @@ void FDC765::writeCmd() {
                     dataIndex = 0;
                 }
 
-                drive[cmdDrive()].buffer = buffer;
                 drive[cmdDrive()].statusReg1 = 0x00;
                 drive[cmdDrive()].statusReg2 |= useDeletedDAM ? 0x40 : 0x00;
-                drive[cmdDrive()].writeSector(cmdHead());
+                drive[cmdDrive()].writeSector(cmdHead(), buffer);
                 drive[cmdDrive()].nextSector();
             }
 
@@ -1212,9 +1236,6 @@ void FDC765::scanCmd() {
 
                     setResultBytesOp();
                 }
-
-                vector<uint8_t> buffer = drive[cmdDrive()].buffer;
-                buffer.resize(dataBytes, 0);
             }
 
             if (((sReg[0] & 0xC0) != 0x00) || currSector == lastSector) {
@@ -1300,6 +1321,7 @@ void FDC765::write(uint_fast8_t value) {
             cmdIndex %= CMDBUFFER_SIZE;
         }
         inputByteReady = true;
+        sleeping = false;
     }
 }
 
@@ -1327,6 +1349,23 @@ void FDC765::motor(bool status) {
     drive[1].motor = status;
 }
 
+void FDC765::flush(bool full) {
+
+    // A file inserted more than once has a copy in each place, with its own
+    // writes. Each copy would overwrite the others, so none is written.
+    set<string> inserted, skip;
+    for (size_t ii = 0; ii < MAX_PLUS3_DRIVES; ++ii) {
+        for (DSKFile const& file : drive[ii].images) {
+            if (!file.fileName.empty() && !inserted.insert(file.fileName).second) {
+                skip.insert(file.fileName);
+            }
+        }
+    }
+
+    drive[0].flush(full, skip);
+    drive[1].flush(full, skip);
+}
+
 void FDC765::randomizeSector(vector<uint8_t>& buf) {
 
     // Theoretically, there is a pattern here. However, this seems to work.
@@ -74,6 +74,9 @@ uint32_t constexpr DATABUFFER_SIZE = 65536;
 uint32_t constexpr RESBUFFER_SIZE = 16;
 uint32_t constexpr CMDBUFFER_SIZE = 16;
 
+/** Most execution steps in a clock, in fast mode. Longer than any seek or search. */
+uint32_t constexpr FAST_STEPS = 4096;
+
 uint32_t constexpr MAX_PLUS3_DRIVES = 2;
 uint32_t constexpr NUM_REGS = 4;
 
@@ -82,6 +85,17 @@ class FDC765 {
     public:
         /** Clock frequency in MHz. */
         float clockFrequency = 1.0;
+        /**
+         * Fast mode. Head loads, seeks and sector searches complete at
+         * once, instead of taking the time of a real drive, and data bytes
+         * wait for the CPU without overrun.
+         */
+        bool fastMode = false;
+        /**
+         * Nothing to do until the CPU sends a byte. The FDC is idle and the
+         * head is unloaded, so it needs no clock.
+         */
+        bool sleeping = false;
         /** Status register. */
         uint_fast8_t statusReg = 0x00;
 
@@ -201,6 +215,8 @@ class FDC765 {
 
         void checkDrive();
         void motor(bool status);
+        /** Write disk changes back to the image files. */
+        void flush(bool full);
         void randomizeSector(std::vector<uint8_t>& buf);
         void appendToDataBuffer(std::vector<uint8_t>& buf);
 };
@@ -0,0 +1,124 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "FileView.h"
+
+#include <fstream>
+#include <utility>
+
+#include "config.h"
+
+#if SPECIDE_ON_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+FileView::FileView(FileView&& other) noexcept {
+
+    *this = std::move(other);
+}
+
+FileView::~FileView() {
+
+    close();
+}
+
+FileView& FileView::operator=(FileView&& other) noexcept {
+
+    if (this != &other) {
+        close();
+        mapped = other.mapped;
+        length = other.length;
+        buffer = std::move(other.buffer);
+        view = mapped ? other.view : buffer.data();
+
+        other.view = nullptr;
+        other.length = 0;
+        other.mapped = false;
+    }
+    return *this;
+}
+
+bool FileView::open(string const& fileName) {
+
+    close();
+
+#if SPECIDE_ON_UNIX
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            view = static_cast<uint8_t const*>(addr);
+            length = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+
+    if (mapped) {
+        return true;
+    }
+#endif
+
+    ifstream ifs(fileName.c_str(), ifstream::binary);
+    if (!ifs.good()) {
+        return false;
+    }
+
+    ifs.seekg(0, ios::end);
+    streamoff size = ifs.tellg();
+    ifs.seekg(0, ios::beg);
+    if (size > 0) {
+        buffer.resize(static_cast<size_t>(size));
+        ifs.read(reinterpret_cast<char*>(buffer.data()), size);
+        buffer.resize(static_cast<size_t>(ifs.gcount()));
+    }
+    view = buffer.data();
+    length = buffer.size();
+    return true;
+}
+
+void FileView::assign(vector<uint8_t>&& bytes) {
+
+    close();
+    buffer = std::move(bytes);
+    view = buffer.data();
+    length = buffer.size();
+}
+
+void FileView::close() {
+
+#if SPECIDE_ON_UNIX
+    if (mapped) {
+        munmap(const_cast<uint8_t*>(view), length);
+    }
+#endif
+
+    buffer.clear();
+    view = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+// vim: et:sw=4:ts=4
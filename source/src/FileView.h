@@ -0,0 +1,75 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** FileView
+ *
+ * Read-only view of a whole file.
+ *
+ * On Unix systems the file is memory mapped, so opening it is immediate and
+ * pages are only read when accessed. Elsewhere, or if mapping fails, the file
+ * is read into memory in a single call.
+ *
+ * File parsers keep a view and read the bytes in place, without copying
+ * them first.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FileView {
+
+    public:
+        FileView() {}
+        FileView(FileView const&) = delete;
+        FileView(FileView&& other) noexcept;
+        ~FileView();
+
+        FileView& operator=(FileView const&) = delete;
+        FileView& operator=(FileView&& other) noexcept;
+
+        /**
+         * Open a file, closing the previous one.
+         *
+         * @return True if the file could be read.
+         */
+        bool open(std::string const& fileName);
+        void close();
+
+        /**
+         * View a buffer that is already in memory, taking ownership of it.
+         */
+        void assign(std::vector<uint8_t>&& bytes);
+
+        uint8_t const* data() const { return view; }
+        size_t size() const { return length; }
+        bool empty() const { return !length; }
+
+        uint8_t const* begin() const { return view; }
+        uint8_t const* end() const { return view + length; }
+
+        uint8_t operator[](size_t index) const { return view[index]; }
+
+    private:
+        uint8_t const* view = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+        std::vector<uint8_t> buffer;    // File contents, if not mapped.
+};
+
+// vim: et:sw=4:ts=4
@@ -317,26 +317,8 @@ class PSG
 
             psgIsAY = ay;
 
-            if (ay) {  // AY-3-8912 (Values by Hacker KAY)
-                int arr[32] = {
-                    0x000, 0x000, 0x034, 0x034, 0x04B, 0x04B, 0x06E, 0x06E,
-                    0x0A3, 0x0A3, 0x0F2, 0x0F2, 0x151, 0x151, 0x227, 0x227,
-                    0x289, 0x289, 0x413, 0x413, 0x5B2, 0x5B2, 0x726, 0x726,
-                    0x906, 0x906, 0xB54, 0xB54, 0xD78, 0xD78, 0xFFF, 0xFFF};
-
-                for (uint_fast8_t i = 0; i < 32; ++i) {
-                    out[i] = arr[i];
-                }
-            } else {      // YM-2149 (Values by Hacker KAY)
-                int arr[32] = {
-                    0x000, 0x000, 0x00F, 0x01C, 0x029, 0x033, 0x03F, 0x04D,
-                    0x060, 0x077, 0x090, 0x0A4, 0x0C3, 0x0EC, 0x113, 0x13A,
-                    0x174, 0x1BF, 0x20D, 0x259, 0x2C9, 0x357, 0x3E5, 0x476,
-                    0x54F, 0x661, 0x773, 0x883, 0xA1D, 0xC0F, 0xE08, 0xFFF};
-
-                for (uint_fast8_t i = 0; i < 32; ++i) {
-                    out[i] = arr[i];
-                }
+            for (uint_fast8_t i = 0; i < 32; ++i) {
+                out[i] = ay ? PSG_AY_LEVELS[i] : PSG_YM_LEVELS[i];
             }
         }
 
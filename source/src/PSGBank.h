@@ -0,0 +1,459 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** PSGBank
+ *
+ * A bank of up to 8 AY-3-8912 PSGs clocked together (TurboSound, Next).
+ *
+ * The state of the chips is kept as structure of arrays, one lane per chip,
+ * so the tone generators, the output stage and the mixer are plain loops
+ * over all lanes that the compiler can vectorise. Only the noise generator
+ * and the envelope, which have per-chip branches, are stepped chip by chip.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SoundDefs.h"
+
+size_t constexpr MAX_PSGS = 8;
+
+class PSGBank
+{
+    public:
+        /** Number of chips in use. */
+        size_t chips = 1;
+
+        /** Selected register address, for each chip. */
+        uint_fast8_t a[MAX_PSGS];
+        /** PSG register banks. */
+        uint_fast8_t r[MAX_PSGS][16];
+
+        /** Output DAC volume levels. */
+        int out[32];
+
+        /** Tone counters. (Channel, chip) */
+        int counter[3][MAX_PSGS];
+        /** Tone period registers. (Channel, chip) */
+        int period[3][MAX_PSGS];
+        /** Tone waveforms. (Channel, chip) */
+        int wave[3][MAX_PSGS];
+        /** Tone disabled in mixer register. (Channel, chip) */
+        int toneOff[3][MAX_PSGS];
+        /** Noise disabled in mixer register. (Channel, chip) */
+        int noiseOff[3][MAX_PSGS];
+        /** Channel volume levels. (Channel, chip) */
+        int volume[3][MAX_PSGS];
+        /** Apply envelope volume to channel. (Channel, chip) */
+        int env[3][MAX_PSGS];
+        /** Current DAC output of each channel. (Channel, chip) */
+        int amplitude[3][MAX_PSGS];
+
+        /** Noise generator period counters. */
+        int counterN[MAX_PSGS];
+        /** Noise generator period registers. */
+        int periodN[MAX_PSGS];
+        /** Noise current values. */
+        int noise[MAX_PSGS];
+        /** Noise current seeds. */
+        int seed[MAX_PSGS];
+
+        /** Envelope counters. */
+        int counterE[MAX_PSGS];
+        /** Envelope period registers. */
+        int periodE[MAX_PSGS];
+        /** Envelope slopes. (Ascending = 1, descending = -1) */
+        int envSlope[MAX_PSGS];
+        /** Envelope volume levels. */
+        int envLevel[MAX_PSGS];
+        /** Envelope steps. The envelope level is derived from this. */
+        int envStep[MAX_PSGS];
+        /** Hold the value of the envelope after one cycle. */
+        bool envHold[MAX_PSGS];
+
+        /** Filter accumulators. (Filter slot, channel, chip) */
+        uint32_t adder[3][3][MAX_PSGS];
+        /** Filter tick counters. All chips are clocked together. */
+        uint32_t ticks[3] {0, 0, 0};
+        /** Current filter slot. */
+        uint32_t index = 0;
+
+        /** Channel samples. (Channel, chip) */
+        int channel[3][MAX_PSGS];
+
+        /** Channel mask for the left output. (Channel, chip) */
+        int maskL[3][MAX_PSGS];
+        /** Channel mask for the right output. (Channel, chip) */
+        int maskR[3][MAX_PSGS];
+        /** Channel attenuation (as a shift) for the left output. */
+        int shiftL[MAX_PSGS];
+        /** Channel attenuation (as a shift) for the right output. */
+        int shiftR[MAX_PSGS];
+
+        /** Output this PSG to the left channel. Only for Next mode. */
+        bool lchan[MAX_PSGS];
+        /** Output this PSG to the right channel. Only for Next mode. */
+        bool rchan[MAX_PSGS];
+
+        /** Clock counter. */
+        uint_fast32_t count = 0;
+
+        /** Generate sound. */
+        bool playSound = true;
+        /** Behave as a AY-3-8912 (oppossed to a YM-2194) */
+        bool psgIsAY = true;
+        /** Current stereo mode. */
+        StereoMode stereo = StereoMode::STEREO_MONO;
+
+        PSGBank() {
+
+            for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                a[ii] = 0;
+                for (size_t rr = 0; rr < 16; ++rr) {
+                    r[ii][rr] = 0x00;
+                }
+
+                for (size_t cc = 0; cc < 3; ++cc) {
+                    counter[cc][ii] = 0;
+                    wave[cc][ii] = 1;
+                    adder[0][cc][ii] = adder[1][cc][ii] = adder[2][cc][ii] = 0;
+                    channel[cc][ii] = 0;
+                }
+
+                counterN[ii] = 0;
+                noise[ii] = 0;
+                counterE[ii] = 0;
+                envSlope[ii] = 1;
+                envLevel[ii] = 0;
+                envStep[ii] = 0;
+                envHold[ii] = false;
+                lchan[ii] = false;
+                rchan[ii] = false;
+                reset(ii);
+            }
+
+            setVolumeLevels(true);
+            setStereo(stereo);
+        }
+
+        void clock() {
+
+            // A period means a complete wave cycle (high/low)
+            // Thus, the clock is not scaled further.
+            if (!(++count & 0x07)) {
+                // Count up, so if the period changes to a lower value than
+                // current we end the pulse.
+                for (size_t cc = 0; cc < 3; ++cc) {
+                    for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                        int end = (++counter[cc][ii] >= period[cc][ii]) ? 1 : 0;
+                        wave[cc][ii] ^= end;
+                        counter[cc][ii] = end ? 0 : counter[cc][ii];
+                    }
+                }
+
+                for (size_t ii = 0; ii < chips; ++ii) {
+                    if (++counterN[ii] >= 2 * periodN[ii]) {
+                        noise[ii] = generateNoise(ii);
+                        counterN[ii] = 0;
+                    }
+
+                    if (++counterE[ii] >= periodE[ii]) {
+                        counterE[ii] = 0;
+                        stepEnvelope(ii);
+                    }
+                }
+            }
+
+            if (playSound) {
+                for (size_t cc = 0; cc < 3; ++cc) {
+                    for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                        int signal = (toneOff[cc][ii] | wave[cc][ii]) & (noiseOff[cc][ii] | noise[ii]);
+                        adder[index][cc][ii] += signal * amplitude[cc][ii];
+                    }
+                }
+            } else {
+                for (size_t cc = 0; cc < 3; ++cc) {
+                    for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                        adder[index][cc][ii] += 1;
+                    }
+                }
+            }
+            ++ticks[index];
+        }
+
+        void sample() {
+
+            uint32_t total = ticks[0] + ticks[1] + ticks[2];
+            for (size_t cc = 0; cc < 3; ++cc) {
+                for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                    channel[cc][ii] = (adder[0][cc][ii] + adder[1][cc][ii] + adder[2][cc][ii]) / total;
+                }
+            }
+
+            index = (index + 1) % 3;
+            for (size_t cc = 0; cc < 3; ++cc) {
+                for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                    adder[index][cc][ii] = 0;
+                }
+            }
+            ticks[index] = 0;
+        }
+
+        /**
+         * Mix all the chips, according to the stereo mode.
+         *
+         * @param left Left channel sample.
+         * @param right Right channel sample.
+         */
+        void mix(int& left, int& right) {
+
+            int l = 0;
+            int r = 0;
+            for (size_t cc = 0; cc < 3; ++cc) {
+                for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                    l += (channel[cc][ii] & maskL[cc][ii]) >> shiftL[ii];
+                    r += (channel[cc][ii] & maskR[cc][ii]) >> shiftR[ii];
+                }
+            }
+
+            left -= l;
+            right -= r;
+        }
+
+        /**
+         * Select the stereo mode, and compute the mixer masks for all chips.
+         *
+         * @param mode The new stereo mode.
+         */
+        void setStereo(StereoMode mode) {
+
+            stereo = mode;
+            for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                updateMix(ii);
+            }
+        }
+
+        /**
+         * Compute the mixer masks for one chip.
+         *
+         * @param chip The chip.
+         */
+        void updateMix(size_t chip) {
+
+            // Channels sent to each side: bit 0 = A, bit 1 = B, bit 2 = C.
+            uint_fast8_t left = 0;
+            uint_fast8_t right = 0;
+            int shift = 0;
+
+            switch (stereo) {
+                case StereoMode::STEREO_ACB:
+                    if (chip == 0) { left = 0x5; right = 0x6; }
+                    break;
+                case StereoMode::STEREO_ABC:
+                    if (chip == 0) { left = 0x3; right = 0x6; }
+                    break;
+                case StereoMode::STEREO_TURBO_MONO:
+                    if (chip < 2) { left = 0x7; right = 0x7; }
+                    break;
+                case StereoMode::STEREO_TURBO_ACB:
+                    if (chip < 2) { left = 0x5; right = 0x6; }
+                    break;
+                case StereoMode::STEREO_TURBO_ABC:
+                    if (chip < 2) { left = 0x3; right = 0x6; }
+                    break;
+                case StereoMode::STEREO_NEXT:
+                    if (chip < 4) {
+                        left = lchan[chip] ? 0x7 : 0x0;
+                        right = rchan[chip] ? 0x7 : 0x0;
+                        shift = 1;
+                    }
+                    break;
+                default:    // mono, all channels go through both sides.
+                    if (chip == 0) { left = 0x7; right = 0x7; }
+                    break;
+            }
+
+            for (size_t cc = 0; cc < 3; ++cc) {
+                maskL[cc][chip] = (left & (1 << cc)) ? -1 : 0;
+                maskR[cc][chip] = (right & (1 << cc)) ? -1 : 0;
+            }
+            shiftL[chip] = shiftR[chip] = shift;
+        }
+
+        uint_fast8_t read(size_t chip) {
+
+            return (!(a[chip] & 0xF0)) ? r[chip][a[chip]] : 0xFF;
+        }
+
+        void write(size_t chip, uint_fast8_t byte) {
+
+            uint_fast8_t reg = a[chip];
+            if (!(reg & 0xF0)) {
+                // Write registers (on AY, take only used bits)
+                r[chip][reg] = byte & (psgIsAY ? PSG_AY_MASKS[reg] : 0xFF);
+
+                switch (reg) {
+                    case 000:
+                    case 001:
+                        // Update tone period for channel A.
+                        period[0][chip] = (r[chip][1] & 0x0F) * 0x100 + r[chip][0];
+                        break;
+
+                    case 002:
+                    case 003:
+                        // Update tone period for channel B.
+                        period[1][chip] = (r[chip][3] & 0x0F) * 0x100 + r[chip][2];
+                        break;
+
+                    case 004:
+                    case 005:
+                        // Update tone period for channel C.
+                        period[2][chip] = (r[chip][5] & 0x0F) * 0x100 + r[chip][4];
+                        break;
+
+                    case 006:
+                        // Update noise period.
+                        periodN[chip] = r[chip][6] & 0x1F;
+                        break;
+
+                    case 007:
+                        // Update mixer.
+                        for (size_t cc = 0; cc < 3; ++cc) {
+                            toneOff[cc][chip] = (r[chip][7] & (0x01 << cc)) ? 1 : 0;
+                            noiseOff[cc][chip] = (r[chip][7] & (0x08 << cc)) ? 1 : 0;
+                        }
+                        break;
+
+                    case 010:
+                    case 011:
+                    case 012:
+                        // Update volume for channel A, B or C.
+                        volume[reg - 010][chip] = 2 * (r[chip][reg] & 0x0F) + 1;
+                        env[reg - 010][chip] = ((r[chip][reg] & 0x10) == 0x10);
+                        updateAmplitude(chip);
+                        break;
+
+                    case 013:
+                    case 014:
+                        // Update period for Envelope generator.
+                        periodE[chip] = r[chip][12] * 0x100 + r[chip][11];
+                        break;
+
+                    case 015:
+                        // Start values depend on the attack bit.
+                        // Attack = 0: Start at 1111, count down.
+                        // Attack = 1: Start at 0000, count up.
+                        if (r[chip][13] != 0xFF) {
+                            envSlope[chip] = ((r[chip][13] & 0x04) == 0x00) ? -1 : 1;
+                            envLevel[chip] = ((r[chip][13] & 0x04) == 0x00) ? 0x1F : 0x00;
+                            envStep[chip] = 0;
+                            envHold[chip] = false;
+                            counterE[chip] = 0;
+                            updateAmplitude(chip);
+                        }
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+
+        void addr(size_t chip, uint_fast8_t byte) {
+
+            a[chip] = byte;
+        }
+
+        void setVolumeLevels(bool ay) {
+
+            psgIsAY = ay;
+
+            for (uint_fast8_t i = 0; i < 32; ++i) {
+                out[i] = ay ? PSG_AY_LEVELS[i] : PSG_YM_LEVELS[i];
+            }
+
+            for (size_t ii = 0; ii < MAX_PSGS; ++ii) {
+                updateAmplitude(ii);
+            }
+        }
+
+        void reset(size_t chip) {
+
+            for (uint_fast8_t i = 0; i < 16; ++i) {
+                r[chip][i] = 0;
+            }
+
+            for (size_t cc = 0; cc < 3; ++cc) {
+                period[cc][chip] = 0;
+                volume[cc][chip] = 0;
+                env[cc][chip] = 0;
+                toneOff[cc][chip] = 0;
+                noiseOff[cc][chip] = 0;
+            }
+
+            periodE[chip] = 0;
+            periodN[chip] = 0;
+            seed[chip] = 0xFFFF;
+            updateAmplitude(chip);
+        }
+
+    private:
+        void updateAmplitude(size_t chip) {
+
+            for (size_t cc = 0; cc < 3; ++cc) {
+                amplitude[cc][chip] = out[env[cc][chip] ? envLevel[chip] : volume[cc][chip]];
+            }
+        }
+
+        void stepEnvelope(size_t chip) {
+
+            if (!envHold[chip]) {
+                uint_fast8_t shape = r[chip][13];
+                if (++envStep[chip] >= 0x20) { // We've finished a cycle.
+                    envStep[chip] = 0x00;
+
+                    // Continue = 1: Cycle pattern controlled by Hold.
+                    if (shape & 0x08) {
+                        // Hold & Alternate
+                        if (shape & 0x01) {
+                            envHold[chip] = true;
+                        }
+
+                        // If Alternate != Hold, change slope. :)
+                        if (((shape & 0x02) >> 1) != (shape & 0x01)) {
+                            envSlope[chip] = -envSlope[chip];
+                        }
+                    } else {
+                        // Continue = 0: Just one cycle, return to 0000.
+                        //               Hold.
+                        envHold[chip] = true;
+                        envSlope[chip] = 1;
+                    }
+                }
+                envLevel[chip] = (envSlope[chip] > 0) ? envStep[chip] : (0x1F - envStep[chip]);
+                updateAmplitude(chip);
+            }
+        }
+
+        int generateNoise(size_t chip) {
+
+            // GenNoise (c) Hacker KAY & Sergey Bulba
+            seed[chip] = (seed[chip] * 2 + 1) ^ (((seed[chip] >> 16) ^ (seed[chip] >> 13)) & 1);
+            return ((seed[chip] >> 16) & 1);
+        }
+};
+// vim: et:sw=4:ts=4
@@ -0,0 +1,112 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PSGRecorder.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+void PSGRecorder::start() {
+
+    data.clear();
+    order.clear();
+    for (size_t ii = 0; ii < 16; ++ii) {
+        last[ii] = pending[ii] = -1;
+    }
+    envelope = false;
+    idle = 0;
+    frames = 0;
+    recording = true;
+}
+
+void PSGRecorder::write(uint_fast8_t reg, uint_fast8_t value) {
+
+    if (reg > 0x0F) {
+        return;
+    }
+
+    if (pending[reg] < 0) {
+        order.push_back(reg);
+    }
+    pending[reg] = value;
+    envelope |= (reg == 0x0D);
+}
+
+void PSGRecorder::frame() {
+
+    bool changes = false;
+    for (vector<uint_fast8_t>::iterator it = order.begin(); it != order.end(); ++it) {
+        if (pending[*it] != last[*it] || (*it == 0x0D && envelope)) {
+            if (!changes) {
+                flushIdle();
+                changes = true;
+            }
+            data.push_back(*it);
+            data.push_back(static_cast<uint8_t>(pending[*it]));
+            last[*it] = pending[*it];
+        }
+        pending[*it] = -1;
+    }
+
+    order.clear();
+    envelope = false;
+    ++idle;
+    ++frames;
+}
+
+void PSGRecorder::flushIdle() {
+
+    // 0xFE n waits for 4 * n frames, 0xFF waits for one frame.
+    while (idle >= 4) {
+        size_t n = (idle / 4 > 0xFF) ? 0xFF : idle / 4;
+        data.push_back(0xFE);
+        data.push_back(static_cast<uint8_t>(n));
+        idle -= 4 * n;
+    }
+
+    while (idle) {
+        data.push_back(0xFF);
+        --idle;
+    }
+}
+
+bool PSGRecorder::save(string const& fileName) {
+
+    // PSG header is:
+    // 0x00 - "PSG" 0x1A
+    // 0x04 - Version number
+    // 0x05 - Interrupt frequency (version 10 and up)
+    // 0x06 - Unused, up to 0x0F
+    uint8_t header[16] = {'P', 'S', 'G', 0x1A, 10, frequency};
+
+    ofstream ofs(fileName, std::ofstream::binary);
+    if (!ofs.good()) {
+        cout << "Cannot write PSG file: " << fileName << endl;
+        return false;
+    }
+
+    flushIdle();
+    ofs.write(reinterpret_cast<char*>(header), sizeof(header));
+    ofs.write(reinterpret_cast<char*>(data.data()), data.size());
+    ofs.put(static_cast<char>(0xFD));
+    ofs.close();
+
+    cout << "Saved " << frames << " frames to " << fileName << endl;
+    return true;
+}
+
+// vim: et:sw=4:ts=4
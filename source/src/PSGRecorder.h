@@ -0,0 +1,87 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** PSGRecorder
+ *
+ * Records the PSG register writes, frame by frame, as a PSG stream.
+ *
+ * Only the last value written to each register during a frame is stored,
+ * and only if it changes the register. Writes to the envelope shape
+ * register are always stored, because they restart the envelope. Runs of
+ * frames without writes are stored as a single 0xFE command.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class PSGRecorder {
+
+    public:
+        /** Record PSG writes. */
+        bool recording = false;
+        /** Interrupt frequency, stored in the header. */
+        uint8_t frequency = 50;
+
+        /** PSG stream, without the header. */
+        std::vector<uint8_t> data;
+
+        /** Number of frames recorded. */
+        size_t frames = 0;
+
+        /**
+         * Start a new recording.
+         */
+        void start();
+
+        /**
+         * Store a register write.
+         *
+         * @param reg The register.
+         * @param value The value written, already masked by the PSG.
+         */
+        void write(uint_fast8_t reg, uint_fast8_t value);
+
+        /**
+         * Finish the current frame.
+         */
+        void frame();
+
+        /**
+         * Save the recording as a PSG file.
+         *
+         * @param fileName The file name.
+         * @return True if the file was written.
+         */
+        bool save(std::string const& fileName);
+
+    private:
+        /** Register values as stored in the stream. */
+        int16_t last[16];
+        /** Register values written during the current frame. */
+        int16_t pending[16];
+        /** Order of the first write to each register in the current frame. */
+        std::vector<uint_fast8_t> order;
+        /** Envelope shape register written during the current frame. */
+        bool envelope = false;
+        /** Frames without writes not yet stored. */
+        size_t idle = 0;
+
+        void flushIdle();
+};
+
+// vim: et:sw=4:ts=4
@@ -32,19 +32,14 @@ uint32_t constexpr pzxTagStop = 'S' | ('T' << 8) | ('O' << 16) | ('P' << 24);
 void PZXFile::load(string const& fileName) {
 
     name = fileName;
-    char c;
 
-    ifstream ifs(fileName.c_str(), ifstream::binary);
-    if (ifs.good()) {
-        fileData.clear();
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
+    if (!fileData.open(fileName)) {
+        cout << "Cannot open file: " << fileName << endl;
     }
 }
 
 void PZXFile::parse(
-        vector<uint32_t> &pulseData,
+        PulseData& pulseData,
         set<size_t> &indexData,
         set<size_t> &stopData,
         set<size_t> &stopIf48K) {
@@ -64,12 +59,15 @@ void PZXFile::parse(
 
     bool concatenate = false;
     uint8_t byte = 0;
+    size_t pilotStart = SIZE_MAX;
+    TapeBlock block;
 
     string blockName;
     ss.str("");
 
     ptr = 0;
     romData.clear();
+    blocks.clear();
 
     if (!pulseData.empty()) {
         indexData.insert(pulseData.size());
@@ -94,6 +92,8 @@ void PZXFile::parse(
 
                 case pzxTagPuls:
                     cout << "PULS ";
+                    // Pilot and sync pulses are part of the next data block.
+                    pilotStart = pulseData.size();
                     // This condition should never happen, since PZX authors must ensure
                     // PULS blocks start on LOW level.
                     concatenate = ((pulseData.size() % 2) != 0);
@@ -123,11 +123,11 @@ void PZXFile::parse(
                         if (val) {
                             if (concatenate) {
                                 concatenate = false;
-                                pulseData.back() += val;
+                                pulseData.extendLast(val);
                                 --rep;
                             }
                             if (rep > 0) {
-                                pulseData.insert(pulseData.end(), rep, val);
+                                pulseData.append(rep, val);
                             }
                         } else if (rep % 2) {   // And val == 0
                             if (!pulseData.size()) {
@@ -169,6 +169,14 @@ void PZXFile::parse(
                     }
 
                     bits &= 0x7FFFFFFF;
+                    block = TapeBlock();
+                    block.type = TAPE_BLOCK_TURBO;
+                    block.start = (pilotStart != SIZE_MAX) ? pilotStart : pulseData.size();
+                    block.data = romData.size();
+                    block.identify(fileData.data() + ptr,
+                            (ptr < nxt) ? min<size_t>(bits >> 3, nxt - ptr) : 0);
+                    pilotStart = SIZE_MAX;
+
                     romData.push_back(((bits >> 3) & 0x00FF));
                     romData.push_back(((bits >> 3) & 0xFF00) >> 8);
                     for (uint32_t ii = 0; ii < bits; ++ii) {
@@ -180,7 +188,7 @@ void PZXFile::parse(
                         }
 
                         size_t bit = ((byte & 0x80) >> 7);
-                        pulseData.insert(pulseData.end(), seqPulses[bit].begin(), seqPulses[bit].end());
+                        pulseData.append(seqPulses[bit].begin(), seqPulses[bit].end());
                     }
 
                     if (tail) {
@@ -188,6 +196,9 @@ void PZXFile::parse(
                     } else {
                         concatenate = !concatenate;
                     }
+
+                    block.end = pulseData.size();
+                    blocks.push_back(block);
                     break;
 
                 case pzxTagPaus:
@@ -21,6 +21,10 @@
 #include <string>
 #include <vector>
 
+#include "FileView.h"
+#include "PulseData.h"
+#include "TapeBlock.h"
+
 /** PZXFile.h
  *
  * PZX file format implementation.
@@ -39,14 +43,15 @@ class PZXFile {
         uint8_t majorVersion = 0;
         uint8_t minorVersion = 0;
 
-        std::vector<uint8_t> fileData;
+        FileView fileData;
         std::vector<uint8_t> romData;
+        std::vector<TapeBlock> blocks;  // Block catalogue. Data offsets are in romData.
 
         std::stringstream ss;   // For reporting.
 
         void load(std::string const& fileName);
         void parse(
-                std::vector<uint32_t> &pulseData,
+                PulseData& pulseData,
                 std::set<size_t> &indexData,
                 std::set<size_t> &stopData,
                 std::set<size_t> &stopIf48K);
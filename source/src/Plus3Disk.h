@@ -19,14 +19,22 @@
  *
  * Plus3 Disk drive emulation.
  *
+ * The drive keeps the tracks under the head for both sides of the current
+ * cylinder. They are found again only when the head moves, when another
+ * disk is inserted, or when a track is formatted, and the sectors pass
+ * under the head without looking up the image.
  */
 
 #include "DSKFile.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <set>
 #include <sstream>
+#include <string>
+#include <utility>
 
 using namespace std;
 
@@ -42,11 +50,15 @@ class Plus3Disk {
         bool writeprot = false; // Disk is write protected
         bool ready = false;     // Drive exists
         bool motor = false;     // Drive motor is spinning.
+        bool writeBack = false; // Write changes back to the image files.
 
         size_t cylinder = 0;
         size_t sector = 0;
         size_t hole = 0;
-        size_t next[2];
+
+        DSKFile* image = nullptr;           // Inserted disk.
+        DSKFile::Track* track[2] = {nullptr, nullptr};  // Current cylinder.
+        size_t trackSectors[2] = {0, 0};    // Sectors in each track.
 
         uint_fast8_t idTrack;
         uint_fast8_t idHead;
@@ -57,11 +69,11 @@ class Plus3Disk {
         uint_fast16_t length;
         uint_fast8_t filler;
         uint_fast8_t gap;
-        vector<uint8_t> buffer;
+        DSKFile::Track::Sector const* sectorRead = nullptr; // Last sector read.
 
         vector<DSKFile> images;
         vector<string> imageNames;
-        size_t currentImage;
+        size_t currentImage = 0;
 
         /**
          * Advance disk to next sector.
@@ -72,22 +84,38 @@ class Plus3Disk {
                 ++sector;
             }
 
-            if (disk) {
-                size_t tr = (images[currentImage].numSides * cylinder);
+            // The index hole comes after the last sector of side 0.
+            if (sector >= trackSectors[0]) {
+                countHole();
+            }
+        }
 
-                if (images[currentImage].tracks[tr].trackSize) {
-                    for (size_t ii = 0; ii < images[currentImage].numSides; ++ii) {
-                        next[ii] = sector % images[currentImage].tracks[tr + ii].numSectors;
+        /**
+         * Find the tracks of the current cylinder.
+         *
+         * This must be called when the head moves, when the disk changes,
+         * or when the tracks of the image change.
+         */
+        void updateCylinder() {
+
+            // The last sector read may be in another track, or image.
+            image = disk ? &images[currentImage] : nullptr;
+            sectorRead = nullptr;
+            for (size_t ii = 0; ii < 2; ++ii) {
+                track[ii] = nullptr;
+                trackSectors[ii] = 0;
+
+                if (image && ii < image->numSides && cylinder < image->numTracks) {
+                    size_t tr = (image->numSides * cylinder) + ii;
+                    if (tr < image->tracks.size() && image->tracks[tr].trackSize
+                            && image->tracks[tr].numSectors
+                            && !image->tracks[tr].sectors.empty()) {
+                        track[ii] = &image->tracks[tr];
+                        trackSectors[ii] = min<size_t>(track[ii]->numSectors,
+                                track[ii]->sectors.size());
                     }
-                } else {
-                    next[0] = 0;
-                    next[1] = 0;
                 }
             }
-
-            if (next[0] == 0) {
-                countHole();
-            }
         }
 
         /**
@@ -101,6 +129,7 @@ class Plus3Disk {
                 cylinder = limit;
             }
             track0 = (cylinder == 0);
+            updateCylinder();
         }
 
         /**
@@ -112,6 +141,7 @@ class Plus3Disk {
                 --cylinder;
             }
             track0 = (cylinder == 0);
+            updateCylinder();
         }
 
         /**
@@ -119,7 +149,7 @@ class Plus3Disk {
          */
         uint_fast8_t senseStatus() {
 
-            return ((disk && images[currentImage].numSides == 2) ? 0x08 : 0x00)
+            return ((image && image->numSides == 2) ? 0x08 : 0x00)
                 | (track0 ? 0x10 : 0x00)
                 | (ready ? 0x20 : 0x00)
                 | (writeprot ? 0x40 : 0x00)
@@ -129,51 +159,41 @@ class Plus3Disk {
         /**
          * Write sector data to disk.
          *
-         * This function writes data from the disk drive buffer to
-         * the disk's current sector.
+         * This function writes data to the disk's current sector, in place.
          *
          */
-        void writeSector(int head) {
-
-            if (disk && head < images[currentImage].numSides) {
-                size_t tr = (images[currentImage].numSides * cylinder) + head;
-                size_t sc = sector % images[currentImage].tracks[tr].numSectors;
-
-                // If the track is formatted, write.
-                if ((tr < images[currentImage].numTracks * images[currentImage].numSides)
-                        && images[currentImage].tracks[tr].trackSize) {
-                    images[currentImage].tracks[tr].sectors[sc].data = buffer;
-                    images[currentImage].tracks[tr].sectors[sc].fdcStatusReg1 = statusReg1;
-                    images[currentImage].tracks[tr].sectors[sc].fdcStatusReg2 = statusReg2;
-                }
+        void writeSector(int head, vector<uint8_t> const& data) {
+
+            // If the track is formatted, write.
+            if (track[head & 1]) {
+                DSKFile::Track::Sector& s = track[head & 1]->sectors[sector % trackSectors[head & 1]];
+                image->store(s, data.data(), data.size());
+                s.fdcStatusReg1 = statusReg1;
+                s.fdcStatusReg2 = statusReg2;
             }
         }
 
         /**
-         * Read sector data into buffer.
+         * Read the ID of the current sector.
          *
-         * This function reads the data from the current sector, and
-         * copies it to the disk drive buffer.
+         * The sector is kept, and its data is copied only when needed.
          */
         void readSector(int head) {
 
-            if (disk && head < images[currentImage].numSides) {
-                size_t tr = (images[currentImage].numSides * cylinder) + head;
-                size_t sc = sector % images[currentImage].tracks[tr].numSectors;
-
+            if (image && head < image->numSides) {
                 // If the track is formatted, read.
-                if ((tr < images[currentImage].numTracks * images[currentImage].numSides)
-                        && images[currentImage].tracks[tr].trackSize) {
-                    idTrack = images[currentImage].tracks[tr].sectors[sc].track;
-                    idHead = images[currentImage].tracks[tr].sectors[sc].side;
-                    idSector = images[currentImage].tracks[tr].sectors[sc].sectorId;
-                    idSize = images[currentImage].tracks[tr].sectors[sc].sectorSize;
-                    statusReg1 = images[currentImage].tracks[tr].sectors[sc].fdcStatusReg1;
-                    statusReg2 = images[currentImage].tracks[tr].sectors[sc].fdcStatusReg2;
-                    buffer = images[currentImage].tracks[tr].sectors[sc].data;
-                    length = images[currentImage].tracks[tr].sectors[sc].sectorLength;
-                    gap = images[currentImage].tracks[tr].gapLength;
-                    filler = images[currentImage].tracks[tr].fillerByte;
+                if (track[head & 1]) {
+                    DSKFile::Track::Sector const& s = track[head & 1]->sectors[sector % trackSectors[head & 1]];
+                    idTrack = s.track;
+                    idHead = s.side;
+                    idSector = s.sectorId;
+                    idSize = s.sectorSize;
+                    statusReg1 = s.fdcStatusReg1;
+                    statusReg2 = s.fdcStatusReg2;
+                    sectorRead = &s;
+                    length = s.sectorLength;
+                    gap = track[head & 1]->gapLength;
+                    filler = track[head & 1]->fillerByte;
                 } else {
                     idTrack = rand() & 0xFF;
                     idHead = rand() & 0xFF;
@@ -181,6 +201,7 @@ class Plus3Disk {
                     idSize = rand() & 0xFF;
                     statusReg1 = 0x25;  // 00100101: DE, ND, MAM
                     statusReg2 = 0x20;  // 00110011: DD, WC, BC, MD
+                    sectorRead = nullptr;
                     length = 0;
                     filler = 0;
                 }
@@ -188,6 +209,50 @@ class Plus3Disk {
             // Should plan for no disk or wrong head.
         }
 
+        /**
+         * Copy data of the last sector read, as stored in the image. Weak
+         * sectors store several copies, one after another.
+         */
+        void readData(size_t offset, size_t size, vector<uint8_t>& data) const {
+
+            if (sectorRead) {
+                image->readData(*sectorRead, offset, size, data);
+            } else {
+                data.clear();
+            }
+        }
+
+        /**
+         * Find a sector by its ID, without moving the head.
+         *
+         * This is used by the ROM disk traps, which read and write sectors
+         * directly. Sectors with errors, or deleted data, are not returned,
+         * so the FDC emulation can reproduce them.
+         *
+         * @return The sector, or nullptr if it cannot be accessed directly.
+         */
+        DSKFile::Track::Sector* findSector(size_t cyl, size_t head, uint_fast8_t id) {
+
+            if (!disk || cyl >= images[currentImage].numTracks
+                    || head >= images[currentImage].numSides) {
+                return nullptr;
+            }
+
+            size_t tr = (images[currentImage].numSides * cyl) + head;
+            if (tr >= images[currentImage].tracks.size()
+                    || !images[currentImage].tracks[tr].trackSize) {
+                return nullptr;
+            }
+
+            for (DSKFile::Track::Sector& s : images[currentImage].tracks[tr].sectors) {
+                if (s.sectorId == id) {
+                    bool error = (s.fdcStatusReg1 & 0x7F) || (s.fdcStatusReg2 & 0x7F);
+                    return error ? nullptr : &s;
+                }
+            }
+            return nullptr;
+        }
+
         void formatTrack(int head,
                 uint_fast8_t trackNumber, uint_fast8_t sideNumber,
                 uint_fast8_t sectorSize, uint_fast8_t numSectors,
@@ -209,24 +274,28 @@ class Plus3Disk {
                         trackNumber, sideNumber, 0x00, sectorSize, 0x00, 0x00));
             images[currentImage].tracks[tr].trackSize = ((0x80 << sectorSize) * numSectors) + 0x100;
             images[currentImage].tracks[tr].magicOk = true;
+
+            // The old sectors are gone, and their space can be reused.
+            images[currentImage].compact();
+            images[currentImage].reshaped = true;
+            images[currentImage].dirty = true;
+            updateCylinder();
         }
 
         void formatSector(int head,
                 uint_fast8_t idTr, uint_fast8_t idHd,
-                uint_fast8_t idSc, uint_fast8_t idSz) {
-
-            if (disk && head < images[currentImage].numSides) {
-                size_t tr = (images[currentImage].numSides * cylinder) + head;
-                size_t sc = sector % images[currentImage].tracks[tr].numSectors;
-
-                images[currentImage].tracks[tr].sectors[sc].track = idTr;
-                images[currentImage].tracks[tr].sectors[sc].side = idHd;
-                images[currentImage].tracks[tr].sectors[sc].sectorId = idSc;
-                images[currentImage].tracks[tr].sectors[sc].sectorSize = idSz;
-                images[currentImage].tracks[tr].sectors[sc].fdcStatusReg1 = 0x00;
-                images[currentImage].tracks[tr].sectors[sc].fdcStatusReg2 = 0x00;
-                images[currentImage].tracks[tr].sectors[sc].sectorLength = buffer.size();
-                images[currentImage].tracks[tr].sectors[sc].data = buffer;
+                uint_fast8_t idSc, uint_fast8_t idSz, uint_fast8_t fillerByte) {
+
+            if (track[head & 1]) {
+                DSKFile::Track::Sector& s = track[head & 1]->sectors[sector % trackSectors[head & 1]];
+                s.track = idTr;
+                s.side = idHd;
+                s.sectorId = idSc;
+                s.sectorSize = idSz;
+                s.fdcStatusReg1 = 0x00;
+                s.fdcStatusReg2 = 0x00;
+                s.sectorLength = 0x80 << idSz;
+                image->allocate(s, 0x80 << idSz, fillerByte);
             }
         }
 
@@ -239,6 +308,7 @@ class Plus3Disk {
             } else {
                 cylinder -= 77;
             }
+            updateCylinder();
         }
 
         /**
@@ -257,12 +327,35 @@ class Plus3Disk {
             ++hole;
         }
 
+        /**
+         * Add an image to the disks of this drive. The first one is
+         * inserted.
+         *
+         * The image is copied. If it is shared, the copy only takes the
+         * index of its tracks and sectors, and the sectors written in this
+         * drive.
+         */
+        void addImage(DSKFile const& image, string const& name) {
+
+            images.push_back(image);
+            imageNames.push_back(name);
+            if (!disk) {
+                currentImage = images.size() - 1;
+                disk = true;
+                ready = true;
+            }
+
+            // The images may have moved.
+            updateCylinder();
+        }
+
         void nextDisk() {
             if (images.size() > 0) {
                 ++currentImage;
                 if (currentImage == images.size()) {
                     currentImage = 0;
                 }
+                updateCylinder();
                 cout << "Currently inserted disk: " << imageNames[currentImage] << endl;
             }
         }
@@ -274,6 +367,7 @@ class Plus3Disk {
                     currentImage = images.size();
                 }
                 --currentImage;
+                updateCylinder();
                 cout << "Currently inserted disk: " << imageNames[currentImage] << endl;
             }
         }
@@ -288,14 +382,35 @@ class Plus3Disk {
 
             DSKFile dsk;
             dsk.makeEmpty();
-            images.push_back(dsk);
+            images.push_back(std::move(dsk));
             imageNames.push_back(ss.str());
             disk = true;
 
             currentImage = images.size() - 1;
+            updateCylinder();
             cout << "Currently inserted disk: " << imageNames[currentImage] << endl;
         }
 
+        /**
+         * Write the changes back to the image files, if enabled.
+         *
+         * @param full Allow rewriting whole files, for formatted tracks.
+         * @param skip Files that must not be written.
+         */
+        void flush(bool full, set<string> const& skip = set<string>()) {
+
+            if (writeBack) {
+                for (DSKFile& file : images) {
+                    if (skip.find(file.fileName) == skip.end()) {
+                        file.flush(full);
+                    } else if (full && file.dirty) {
+                        cout << "Not writing " << file.fileName
+                            << ", which is inserted more than once." << endl;
+                    }
+                }
+            }
+        }
+
         void saveDisk() {
 
             static size_t disks = 0;
@@ -0,0 +1,374 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "PulseData.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// A segment costs about as much as 256 pair bits, so shorter runs are
+// better stored as bits when a second pulse length appears.
+uint32_t constexpr PAIR_THRESHOLD = 256;
+// Pair segments shorter than this are stored as raw pulses.
+uint32_t constexpr RAW_THRESHOLD = 8;
+// Raw segments are limited, so seeking inside them is bounded.
+uint32_t constexpr RAW_MAX = 4096;
+// Identical pulses at the end of a raw segment are moved to a run.
+uint32_t constexpr RUN_SPLIT = 32;
+// Pulses taking two lengths at the end of a raw segment are moved to a pair.
+// A segment costs about as much as 40 raw bytes, so this keeps sampled
+// tapes from splitting into many short pairs.
+uint32_t constexpr PAIR_SPLIT = 64;
+
+void PulseData::clear() {
+
+    segments.clear();
+    bits.clear();
+    bytes.clear();
+    pulses = 0;
+    tailCount = 0;
+}
+
+void PulseData::push_back(uint32_t pulse) {
+
+    if (segments.empty()) {
+        startSegment(RUN, pulse);
+    } else {
+        PulseSegment& s = segments.back();
+        switch (s.type) {
+            case RUN:
+                if (pulse == s.symbol[0]) {
+                    ++s.count;
+                } else if (s.count <= PAIR_THRESHOLD) {
+                    s.type = PAIR;
+                    s.offset = bits.size();
+                    s.symbol[1] = pulse;
+                    bits.insert(bits.end(), s.count, false);
+                    bits.push_back(true);
+                    ++s.count;
+                } else {
+                    startSegment(RUN, pulse);
+                }
+                break;
+
+            case PAIR:
+                if (pulse == s.symbol[0] || pulse == s.symbol[1]) {
+                    bits.push_back(pulse == s.symbol[1]);
+                    ++s.count;
+                } else if (s.count < RAW_THRESHOLD) {
+                    toRaw(s);
+                    pushRaw(pulse);
+                } else {
+                    startSegment(RUN, pulse);
+                }
+                break;
+
+            default:
+                pushRaw(pulse);
+                break;
+        }
+    }
+
+    ++pulses;
+}
+
+void PulseData::append(size_t n, uint32_t pulse) {
+
+    for (size_t ii = 0; ii < n; ++ii) {
+        push_back(pulse);
+    }
+}
+
+uint32_t PulseData::back() const {
+
+    PulseSegment const& s = segments.back();
+    switch (s.type) {
+        case RUN:
+            return s.symbol[0];
+
+        case PAIR:
+            return s.symbol[bits.back() ? 1 : 0];
+
+        default:
+            {
+                size_t byte = bytes.size() - 1;
+                while (byte > s.offset && (bytes[byte - 1] & 0x80)) {
+                    --byte;
+                }
+                return readRaw(byte);
+            }
+    }
+}
+
+void PulseData::extendLast(uint32_t pulse) {
+
+    uint32_t last = back();
+    popBack();
+    push_back(last + pulse);
+}
+
+uint32_t PulseData::operator[](size_t index) const {
+
+    PulseCursor cursor;
+    seek(cursor, index);
+    return next(cursor);
+}
+
+void PulseData::seek(PulseCursor& cursor, size_t index) const {
+
+    cursor.pulse = 0;
+    cursor.byte = 0;
+    if (index >= pulses) {
+        cursor.segment = segments.size();
+        return;
+    }
+
+    vector<PulseSegment>::const_iterator it = upper_bound(segments.begin(), segments.end(), index,
+            [](size_t i, PulseSegment const& s) { return i < s.start; });
+    cursor.segment = (it - segments.begin()) - 1;
+
+    PulseSegment const& s = segments[cursor.segment];
+    cursor.pulse = static_cast<uint32_t>(index - s.start);
+    if (s.type == RAW) {
+        cursor.byte = s.offset;
+        for (uint32_t ii = 0; ii < cursor.pulse; ++ii) {
+            readRaw(cursor.byte);
+        }
+    }
+}
+
+uint32_t PulseData::next(PulseCursor& cursor) const {
+
+    PulseSegment const& s = segments[cursor.segment];
+
+    uint32_t pulse;
+    switch (s.type) {
+        case RUN:
+            pulse = s.symbol[0];
+            break;
+
+        case PAIR:
+            pulse = s.symbol[bits[s.offset + cursor.pulse] ? 1 : 0];
+            break;
+
+        default:
+            pulse = readRaw(cursor.byte);
+            break;
+    }
+
+    if (++cursor.pulse >= s.count) {
+        cursor.pulse = 0;
+        if (++cursor.segment < segments.size()) {
+            cursor.byte = segments[cursor.segment].offset;
+        }
+    }
+
+    return pulse;
+}
+
+size_t PulseData::memory() const {
+
+    return segments.capacity() * sizeof(PulseSegment)
+        + bits.capacity() / 8 + bytes.capacity();
+}
+
+void PulseData::startSegment(uint8_t type, uint32_t pulse) {
+
+    PulseSegment s;
+    s.start = segments.empty() ? 0 : segments.back().start + segments.back().count;
+    s.offset = (type == RAW) ? bytes.size() : 0;
+    s.count = 0;
+    s.symbol[0] = pulse;
+    s.symbol[1] = 0;
+    s.type = type;
+    segments.push_back(s);
+
+    if (type == RAW) {
+        pushRaw(pulse);
+    } else {
+        segments.back().count = 1;
+    }
+}
+
+void PulseData::toRaw(PulseSegment& segment) {
+
+    // Recover the pulses of this segment, which is the last one.
+    vector<uint32_t> values;
+    for (uint32_t ii = 0; ii < segment.count; ++ii) {
+        bool bit = (segment.type == PAIR) && bits[segment.offset + ii];
+        values.push_back(segment.symbol[bit ? 1 : 0]);
+    }
+    if (segment.type == PAIR) {
+        bits.resize(segment.offset);
+    }
+
+    // Append them to the previous raw segment if there is one.
+    if (segments.size() > 1 && segments[segments.size() - 2].type == RAW) {
+        segments.pop_back();
+    } else {
+        segment.type = RAW;
+        segment.offset = bytes.size();
+        segment.count = 0;
+        segment.symbol[0] = segment.symbol[1] = 0;
+    }
+
+    for (uint32_t value : values) {
+        pushRaw(value);
+    }
+}
+
+void PulseData::pushRaw(uint32_t pulse) {
+
+    if (segments.back().type != RAW || segments.back().count >= RAW_MAX) {
+        startSegment(RAW, pulse);
+        return;
+    }
+
+    PulseSegment& s = segments.back();
+
+    // Variable length integer, 7 bits per byte, LSB first.
+    uint32_t value = pulse;
+    size_t length = 1;
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>((value & 0x7F) | 0x80));
+        value >>= 7;
+        ++length;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+    ++s.count;
+
+    // Track the trailing pulses that take at most two lengths. This uses
+    // the trailing run before it is updated.
+    if (s.count == 1) {
+        tail[0] = tail[1] = pulse;
+        tailCount = 1;
+    } else if (pulse == tail[0] || pulse == tail[1]) {
+        ++tailCount;
+    } else if (tail[0] == tail[1]) {
+        tail[1] = pulse;
+        ++tailCount;
+    } else {
+        tail[0] = s.symbol[0];
+        tail[1] = pulse;
+        tailCount = s.symbol[1] + 1;
+    }
+
+    // Track the trailing run of identical pulses.
+    if (pulse == s.symbol[0]) {
+        ++s.symbol[1];
+    } else {
+        s.symbol[0] = pulse;
+        s.symbol[1] = 1;
+    }
+
+    if (s.symbol[1] >= RUN_SPLIT) {
+        uint32_t run = s.symbol[1];
+        bytes.resize(bytes.size() - run * length);
+        s.count -= run;
+        if (s.count) {
+            // The trailing pulses of the raw segment are no longer known.
+            s.symbol[0] = s.symbol[1] = 0;
+            tailCount = 0;
+            startSegment(RUN, pulse);
+            segments.back().count = run;
+        } else {
+            s.type = RUN;
+            s.offset = 0;
+            s.count = run;
+            s.symbol[1] = 0;
+        }
+    } else if (tailCount >= PAIR_SPLIT && tail[0] != tail[1]) {
+        splitPair();
+    }
+}
+
+void PulseData::splitPair() {
+
+    PulseSegment& s = segments.back();
+
+    // Skip the pulses that stay in the raw segment.
+    size_t byte = s.offset;
+    for (uint32_t ii = tailCount; ii < s.count; ++ii) {
+        readRaw(byte);
+    }
+
+    PulseSegment p;
+    p.start = s.start + s.count - tailCount;
+    p.offset = bits.size();
+    p.count = tailCount;
+    p.symbol[0] = tail[0];
+    p.symbol[1] = tail[1];
+    p.type = PAIR;
+
+    size_t first = byte;
+    while (byte < bytes.size()) {
+        bits.push_back(readRaw(byte) == tail[1]);
+    }
+    bytes.resize(first);
+
+    s.count -= tailCount;
+    tailCount = 0;
+    if (s.count) {
+        s.symbol[0] = s.symbol[1] = 0;
+        segments.push_back(p);
+    } else {
+        s = p;
+    }
+}
+
+void PulseData::popBack() {
+
+    PulseSegment& s = segments.back();
+    switch (s.type) {
+        case RUN:
+            break;
+
+        case PAIR:
+            bits.pop_back();
+            break;
+
+        default:
+            {
+                size_t byte = bytes.size() - 1;
+                while (byte > s.offset && (bytes[byte - 1] & 0x80)) {
+                    --byte;
+                }
+                bytes.resize(byte);
+                s.symbol[1] = s.symbol[1] ? s.symbol[1] - 1 : 0;
+                tailCount = tailCount ? tailCount - 1 : 0;
+            }
+            break;
+    }
+
+    if (!--s.count) {
+        segments.pop_back();
+    }
+    --pulses;
+}
+
+uint32_t PulseData::readRaw(size_t& byte) const {
+
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    while (bytes[byte] & 0x80) {
+        value |= static_cast<uint32_t>(bytes[byte++] & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint32_t>(bytes[byte++]) << shift;
+    return value;
+}
+
+// vim: et:sw=4:ts=4
@@ -0,0 +1,126 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** PulseData
+ *
+ * Compressed storage for tape pulses.
+ *
+ * Pulses are appended one by one, and stored as segments:
+ * - Runs: a number of identical pulses (pilot tones, pauses).
+ * - Pairs: pulses taking one of two lengths, one bit per pulse (data).
+ * - Raw: anything else, as variable length integers (sampled tapes).
+ *
+ * Pulses are read back sequentially through a cursor.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+struct PulseSegment {
+
+    size_t start;           // Index of the first pulse.
+    size_t offset;          // Offset of the pair bits, or the raw bytes.
+    uint32_t count;         // Number of pulses.
+    uint32_t symbol[2];     // Pulse lengths, for runs and pairs.
+    uint8_t type;           // Run, pair or raw.
+};
+
+struct PulseCursor {
+
+    size_t segment = 0;     // Current segment.
+    uint32_t pulse = 0;     // Pulse within the segment.
+    size_t byte = 0;        // Byte offset, for raw segments.
+};
+
+class PulseData {
+
+    public:
+        static uint8_t constexpr RUN = 0;
+        static uint8_t constexpr PAIR = 1;
+        static uint8_t constexpr RAW = 2;
+
+        std::vector<PulseSegment> segments;
+        std::vector<bool> bits;         // Pair segment bits.
+        std::vector<uint8_t> bytes;     // Raw segment pulses.
+
+        size_t size() const { return pulses; }
+        bool empty() const { return !pulses; }
+
+        void clear();
+
+        void push_back(uint32_t pulse);
+        void append(size_t n, uint32_t pulse);
+
+        template <class It,
+                 class = std::enable_if_t<!std::is_integral<It>::value>>
+        void append(It first, It last) {
+            for (; first != last; ++first) {
+                push_back(*first);
+            }
+        }
+
+        /**
+         * Get the last pulse.
+         */
+        uint32_t back() const;
+
+        /**
+         * Make the last pulse longer.
+         *
+         * @param pulse Length to add to the last pulse.
+         */
+        void extendLast(uint32_t pulse);
+
+        /**
+         * Get any pulse. This is slow, use a cursor for playback.
+         */
+        uint32_t operator[](size_t index) const;
+
+        /**
+         * Place a cursor at a given pulse.
+         */
+        void seek(PulseCursor& cursor, size_t index) const;
+
+        /**
+         * Read the pulse under the cursor, and move the cursor forward.
+         */
+        uint32_t next(PulseCursor& cursor) const;
+
+        /**
+         * Memory used by the pulse data, in bytes.
+         */
+        size_t memory() const;
+
+    private:
+        size_t pulses = 0;
+
+        // Trailing pulses of the last raw segment that take at most two
+        // lengths, so they can be moved to a pair segment.
+        uint32_t tail[2] = {0, 0};
+        uint32_t tailCount = 0;
+
+        void startSegment(uint8_t type, uint32_t pulse);
+        void toRaw(PulseSegment& segment);
+        void pushRaw(uint32_t pulse);
+        void splitPair();
+        void popBack();
+        uint32_t readRaw(size_t& byte) const;
+};
+
+// vim: et:sw=4:ts=4
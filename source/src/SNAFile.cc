@@ -27,14 +27,9 @@ using namespace std;
 void SNAFile::load(string const& fileName) {
 
     name = fileName;
-    char c;
 
-    ifstream ifs(fileName.c_str(), ifstream::binary);
-    if (ifs.good()) {
-        fileData.clear();
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
+    if (!fileData.open(fileName)) {
+        cout << "Cannot open file: " << fileName << endl;
     }
 }
 
@@ -99,15 +94,15 @@ bool SNAFile::fillMemory() {
     uint32_t membase = 27;
     uint32_t p = state.port_0x7ffd & 0x7;
 
-    state.memory[5].assign(&fileData[membase + 0x0000], &fileData[membase + 0x4000]);
-    state.memory[2].assign(&fileData[membase + 0x4000], &fileData[membase + 0x8000]);
-    state.memory[p].assign(&fileData[membase + 0x8000], &fileData[membase + 0xC000]);
+    state.memory[5].assign(fileData.data() + membase + 0x0000, fileData.data() + membase + 0x4000);
+    state.memory[2].assign(fileData.data() + membase + 0x4000, fileData.data() + membase + 0x8000);
+    state.memory[p].assign(fileData.data() + membase + 0x8000, fileData.data() + membase + 0xC000);
 
     if (state.type == SnapType::SNA_128) {
         membase = 49183;
         for (size_t ii = 0; ii < 8; ++ii) {
             if (ii != 5 && ii != 2 && ii != p) {
-                state.memory[ii].assign(&fileData[membase], &fileData[membase + 0x4000]);
+                state.memory[ii].assign(fileData.data() + membase, fileData.data() + membase + 0x4000);
                 membase += 0x4000;
             }
         }
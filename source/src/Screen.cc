@@ -184,7 +184,23 @@ void Screen::setup() {
     w *= scale;
     h *= scale;
 
-    chooseVideoMode();
+    headless = (options["headless"] == "yes");
+    cout << "Headless mode: " << options["headless"] << endl;
+    if (headless) {
+        headlessFrames = getNumber("frames", 15000);
+        cout << "Headless frames: " << headlessFrames << endl;
+    } else {
+        chooseVideoMode();
+    }
+
+    psgRecord = (options["psgrec"] == "yes");
+    cout << "Record PSG: " << options["psgrec"] << endl;
+
+    micRecord = (options["micrec"] == "yes");
+    cout << "Record tape output: " << options["micrec"] << endl;
+
+    turboTape = (options["turbotape"] == "yes");
+    cout << "Turbo tape loading: " << options["turbotape"] << endl;
 
     fullscreen = (options["fullscreen"] == "yes");
     cout << "Full screen mode: " << options["fullscreen"] << endl;
@@ -241,6 +257,47 @@ void Screen::adjustViewPort() {
     cout << "Selected " << suggestedScansDouble << " scans for double scan mode." << endl;
 }
 
+string Screen::psgRecordName() {
+
+    if (files.empty()) {
+        return "psgrec.psg";
+    }
+
+    string name = files.front();
+    return name.substr(0, name.find_last_of('.')) + ".psg";
+}
+
+string Screen::micRecordName() {
+
+    string extension = options["micformat"];
+    if (extension != "tzx" && extension != "csw") {
+        extension = "pzx";
+    }
+
+    if (files.empty()) {
+        return "micrec." + extension;
+    }
+
+    string name = files.front();
+    return name.substr(0, name.find_last_of('.')) + "_mic." + extension;
+}
+
+DSKFile const* Screen::loadDisk(string const& fileName) {
+
+    map<string, DSKFile>::iterator it = diskImages.find(fileName);
+    if (it == diskImages.end()) {
+        DSKFile dsk;
+        dsk.load(fileName);
+        if (!dsk.validFile) {
+            return nullptr;
+        }
+
+        dsk.share();
+        it = diskImages.emplace(fileName, std::move(dsk)).first;
+    }
+    return &it->second;
+}
+
 FileTypes Screen::guessFileType(string const& fileName) {
 
     // Parse the file name, find the extension. We'll decide what to do
@@ -265,6 +322,8 @@ FileTypes Screen::guessFileType(string const& fileName) {
         return FileTypes::FILETYPE_PZX;
     } else if (extension == ".dsk") {
         return FileTypes::FILETYPE_DSK;
+    } else if (extension == ".trd" || extension == ".scl") {
+        return FileTypes::FILETYPE_TRD;
     } else if (extension == ".csw") {
         return FileTypes::FILETYPE_CSW;
     } else if (extension == ".z80") {
@@ -29,6 +29,7 @@
  */
 
 #include "CommonDefs.h"
+#include "DSKFile.h"
 
 #if (SPECIDE_SDL2==1)
 #else
@@ -43,6 +44,9 @@
 #include <map>
 #include <vector>
 
+/** Time between screen updates while loading in turbo mode (microseconds). */
+uint32_t constexpr TURBO_UPDATE_TIME = 40000;
+
 class Screen {
 
     public:
@@ -66,6 +70,8 @@ class Screen {
         std::map<std::string, std::string> options;
         /** Vector of file names as strings. */
         std::vector<std::string> files;
+        /** Disk images loaded, shared by the drives they are inserted in. */
+        std::map<std::string, DSKFile> diskImages;
 
 #if (SPECIDE_SDL2==1)
 #else
@@ -108,6 +114,16 @@ class Screen {
         bool fullscreen = false;
         /** Sync to video mode active. */
         bool syncToVideo = false;
+        /** Run without window or sound, as fast as possible. */
+        bool headless = false;
+        /** Frames to run in headless mode. */
+        uint32_t headlessFrames = 0;
+        /** Record PSG register writes. */
+        bool psgRecord = false;
+        /** Record the tape output. */
+        bool micRecord = false;
+        /** Run as fast as possible while a tape is loading. */
+        bool turboTape = false;
         /** Use a wide screen mode. */
         bool wide = false;
 
@@ -332,11 +348,36 @@ class Screen {
          */
         virtual void keyRelease(sf::Keyboard::Scancode key) = 0;
 
+        /**
+         * Name of the PSG recording, based on the first file loaded.
+         *
+         * @return The first file name with a .psg extension.
+         */
+        std::string psgRecordName();
+
+        /**
+         * Name of the tape output recording, based on the first file loaded.
+         *
+         * @return The first file name, with _mic and the selected format
+         *         as extension.
+         */
+        std::string micRecordName();
+
         /**
          * Guess file type based on the extension.
          */
         FileTypes guessFileType(std::string const& filename);
 
+        /**
+         * Load a DSK image, or find it if it was loaded before.
+         *
+         * The sector data of the image is shared, so inserting it in
+         * several drives does not copy it.
+         *
+         * @return The image, or nullptr if it is not valid.
+         */
+        DSKFile const* loadDisk(std::string const& fileName);
+
         /**
          * Recreate the emulator window after toggling full screen mode.
          *
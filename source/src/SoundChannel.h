@@ -21,8 +21,13 @@
  *
  * It generates 44100Hz, 16-bit sound.
  *
+ * In adaptive mode, the number of buffers queued before and during playback
+ * follows the measured stability of the audio callback: an underrun adds
+ * a buffer, and a long enough run with a spare buffer always queued removes
+ * one. This keeps latency at the lowest value the system can sustain.
  */
 
+#include <algorithm>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
@@ -36,6 +41,24 @@
 constexpr size_t MAX_BUFFERS = 16;
 constexpr size_t MAX_SAMPLES = 2048;
 constexpr uint32_t PRELOAD_BUFFERS = 3;
+constexpr uint32_t MIN_PRELOAD_BUFFERS = 1;
+constexpr uint32_t MAX_PRELOAD_BUFFERS = MAX_BUFFERS / 2;
+/** Callbacks without underruns needed before trying a lower latency. */
+constexpr uint32_t ADAPT_WINDOW = 250;
+
+struct SoundStats {
+
+    /** Buffers queued before starting playback. */
+    uint32_t preload = PRELOAD_BUFFERS;
+    /** Times the audio callback found no buffer ready. */
+    uint32_t underruns = 0;
+    /** Buffers dropped to bring latency down to the target. */
+    uint32_t drops = 0;
+    /** Jitter of the audio callback interval (microseconds). */
+    int64_t jitter = 0;
+    /** Estimated queued latency (milliseconds). */
+    uint32_t latency = 0;
+};
 
 class SoundChannel : public sf::SoundStream {
 
@@ -52,18 +75,24 @@ class SoundChannel : public sf::SoundStream {
         std::condition_variable cv;
 
         uint32_t channels;
+        uint32_t rate;
 
         bool destroy = false;
 
+        /** Adapt the number of buffers to the measured callback jitter. */
+        bool adaptive = false;
+        SoundStats stats;
+
         SoundChannel() :
             buffers(MAX_BUFFERS, (std::vector<sf::Int16>())),
             samples(MAX_BUFFERS, 0) {}
 
-        bool open(unsigned int chan, unsigned int rate) {
+        bool open(unsigned int chan, unsigned int sampleRate) {
 
             channels = chan;
+            rate = sampleRate;
 
-            initialize(chan, rate);
+            initialize(chan, sampleRate);
             queuedBuffers.clear();
 
             // Reserve buffer space
@@ -75,7 +104,7 @@ class SoundChannel : public sf::SoundStream {
             setAttenuation(0);
             setVolume(100);
             cout << "Initialized " << channels << " channels ";
-            cout << "at " << rate << " Hz." << endl;
+            cout << "at " << sampleRate << " Hz." << endl;
             return true;
         }
 
@@ -97,6 +126,12 @@ class SoundChannel : public sf::SoundStream {
                 samples[wrBuffer] = channels * wrSample;
                 queuedBuffers.push_back(wrBuffer);
                 wrSample = 0;
+
+                // Allow one buffer over the target for the callback jitter.
+                if (adaptive && queuedBuffers.size() > stats.preload + 1) {
+                    queuedBuffers.pop_front();
+                    ++stats.drops;
+                }
                 do {
                     wrBuffer = (wrBuffer + 1) % MAX_BUFFERS;
                 } while ((wrBuffer == rdBuffer)
@@ -111,19 +146,81 @@ class SoundChannel : public sf::SoundStream {
                 queuedBuffers.clear();
             }
             cv.notify_one();
-            return (queuedBuffers.size() >= PRELOAD_BUFFERS);
+            return (queuedBuffers.size() >= (adaptive ? stats.preload : PRELOAD_BUFFERS));
         }
 
         void close() {
 
             destroy = true;
             cv.notify_one();
+
+            if (adaptive) {
+                SoundStats s = getStats();
+                cout << "Sound latency: " << s.latency << " ms (" << s.preload << " buffers), ";
+                cout << s.underruns << " underruns, " << s.drops << " drops, ";
+                cout << "jitter " << s.jitter << " us." << endl;
+            }
+        }
+
+        SoundStats getStats() {
+
+            std::lock_guard<std::mutex> lock(m);
+            stats.latency = static_cast<uint32_t>(
+                    (1000 * stats.preload * lastSamples) / (channels * rate));
+            return stats;
         }
 
     private:
+        /** Samples in the last buffer played, to estimate latency. */
+        size_t lastSamples = 0;
+
+        sf::Clock callbackClock;
+        uint32_t windowCount = 0;
+        size_t windowMinQueued = MAX_BUFFERS;
+        int64_t windowMinInterval = INT64_MAX;
+        int64_t windowMaxInterval = 0;
+
+        void underrun() {
+
+            ++stats.underruns;
+            if (stats.preload < MAX_PRELOAD_BUFFERS) {
+                ++stats.preload;
+            }
+            resetWindow();
+        }
+
+        void adapt() {
+
+            int64_t interval = callbackClock.restart().asMicroseconds();
+            windowMinInterval = std::min(windowMinInterval, interval);
+            windowMaxInterval = std::max(windowMaxInterval, interval);
+            windowMinQueued = std::min(windowMinQueued, queuedBuffers.size());
+
+            if (++windowCount >= ADAPT_WINDOW) {
+                stats.jitter = windowMaxInterval - windowMinInterval;
+                // A spare buffer was always there, so one less is still safe.
+                if (windowMinQueued > 0 && stats.preload > MIN_PRELOAD_BUFFERS) {
+                    --stats.preload;
+                }
+                resetWindow();
+            }
+        }
+
+        void resetWindow() {
+
+            windowCount = 0;
+            windowMinQueued = MAX_BUFFERS;
+            windowMinInterval = INT64_MAX;
+            windowMaxInterval = 0;
+        }
+
         virtual bool onGetData(Chunk& data) {
 
             std::unique_lock<std::mutex> lock(m);
+            if (adaptive && !destroy && queuedBuffers.empty()) {
+                underrun();
+            }
+
             while (!destroy && queuedBuffers.empty()) {
                 cv.wait(lock);
             }
@@ -134,7 +231,12 @@ class SoundChannel : public sf::SoundStream {
                 queuedBuffers.pop_front();
                 data.sampleCount = samples[rdBuffer];
                 data.samples = &(buffers[rdBuffer])[0];
+                lastSamples = samples[rdBuffer];
                 play = true;
+
+                if (adaptive) {
+                    adapt();
+                }
             }
             return play;
         }
@@ -35,6 +35,25 @@ int constexpr ULA_LOAD_VOLUME = 0x01FF;
 
 int constexpr COVOX_VOLUME = 0x20;
 
+// AY-3-8912 DAC levels (Values by Hacker KAY)
+int constexpr PSG_AY_LEVELS[32] = {
+    0x000, 0x000, 0x034, 0x034, 0x04B, 0x04B, 0x06E, 0x06E,
+    0x0A3, 0x0A3, 0x0F2, 0x0F2, 0x151, 0x151, 0x227, 0x227,
+    0x289, 0x289, 0x413, 0x413, 0x5B2, 0x5B2, 0x726, 0x726,
+    0x906, 0x906, 0xB54, 0xB54, 0xD78, 0xD78, 0xFFF, 0xFFF};
+
+// YM-2149 DAC levels (Values by Hacker KAY)
+int constexpr PSG_YM_LEVELS[32] = {
+    0x000, 0x000, 0x00F, 0x01C, 0x029, 0x033, 0x03F, 0x04D,
+    0x060, 0x077, 0x090, 0x0A4, 0x0C3, 0x0EC, 0x113, 0x13A,
+    0x174, 0x1BF, 0x20D, 0x259, 0x2C9, 0x357, 0x3E5, 0x476,
+    0x54F, 0x661, 0x773, 0x883, 0xA1D, 0xC0F, 0xE08, 0xFFF};
+
+// AY-3-8912 register valid bits mask.
+uint_fast8_t constexpr PSG_AY_MASKS[16] = {
+    0xFF, 0x0F, 0xFF, 0x0F, 0xFF, 0x0F, 0x1F, 0xFF,
+    0x1F, 0x1F, 0x1F, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF};
+
 int constexpr CPC_SAVE_VOLUME = 0x03FF;
 int constexpr CPC_LOAD_VOLUME = 0x01FF;
 
@@ -70,6 +89,11 @@ struct Filter {
         ++ticks[index];
     }
 
+    void add(uint_fast16_t sample, uint_fast32_t span) {
+        adder[index] += sample * span;
+        ticks[index] += span;
+    }
+
     uint_fast16_t get() {
         sound = (adder[0] + adder[1] + adder[2]) / (ticks[0] + ticks[1] + ticks[2]);
         index = (index + 1) % 3;
@@ -20,6 +20,7 @@
 #include "SpecIde.h"
 #include "SpeccyScreen.h"
 #include "CpcScreen.h"
+#include "Tape.h"
 
 #include "config.h"
 
@@ -63,6 +64,12 @@ map<string, Option> arguments = {
     {"--notapesound",   {"tapesound", "no"}},
     {"--sound",         {"sound", "yes"}},
     {"--nosound",       {"sound", "no"}},
+    {"--lowlatency",    {"lowlatency", "yes"}},
+    {"--nolowlatency",  {"lowlatency", "no"}},
+    {"--psgrec",        {"psgrec", "yes"}},
+    {"--nopsgrec",      {"psgrec", "no"}},
+    {"--micrec",        {"micrec", "yes"}},
+    {"--nomicrec",      {"micrec", "no"}},
     {"--psg",           {"forcepsg", "yes"}},
     {"--nopsg",         {"forcepsg", "no"}},
     {"--abc",           {"stereo", "abc"}},
@@ -90,12 +97,24 @@ map<string, Option> arguments = {
     {"--fullscreen",    {"fullscreen", "yes"}},
     {"--sync",          {"sync", "yes"}},
     {"--nosync",        {"sync", "no"}},
+    {"--headless",      {"headless", "yes"}},
+    {"--noheadless",    {"headless", "no"}},
     {"--cmos",          {"z80type", "cmos"}},
     {"--nmos",          {"z80type", "nmos"}},
 
     // Switches
     {"--flashtap",      {"flashtap", "yes"}},
     {"--noflashtap",    {"flashtap", "no"}},
+    {"--flashdsk",      {"flashdsk", "yes"}},
+    {"--noflashdsk",    {"flashdsk", "no"}},
+    {"--turbotape",     {"turbotape", "yes"}},
+    {"--noturbotape",   {"turbotape", "no"}},
+    {"--edgeloops",     {"edgeloops", "yes"}},
+    {"--noedgeloops",   {"edgeloops", "no"}},
+    {"--fastdisk",      {"fastdisk", "yes"}},
+    {"--nofastdisk",    {"fastdisk", "no"}},
+    {"--diskwrite",     {"diskwrite", "yes"}},
+    {"--nodiskwrite",   {"diskwrite", "no"}},
 
     // SD1 was a protection device used in Camelot Warriors.
     {"--sd1",           {"sd1", "yes"}},
@@ -121,10 +140,13 @@ int main(int argc, char* argv[]) {
     // the config file.
     vector<string> params(argv + 1, argv + argc);
     vector<string> files;
+    bool list = false;
     for (vector<string>::iterator it = params.begin(); it != params.end(); ++it) {
         if (*it == "--help" || *it == "-h") {
             displayHelp();
             exit(0);
+        } else if (*it == "--list") {
+            list = true;
         }
     }
 
@@ -132,11 +154,22 @@ int main(int argc, char* argv[]) {
         map<string, Option>::iterator argument = arguments.find(*it);
         if (argument != arguments.end()) {
             options[argument->second.name] = argument->second.value;
+        } else if (*it == "--driveb" && (it + 1) != params.end()) {
+            // The next file is inserted in the second disk drive.
+            options["driveb"] = *++it;
+        } else if (*it == "--tapeblock" && (it + 1) != params.end()) {
+            // The tape starts at this block.
+            options["tapeblock"] = *++it;
         } else if (it->find('.') != string::npos) {
             files.push_back(*it);
         }
     }
 
+    if (list) {
+        listTapes(files);
+        exit(0);
+    }
+
     // Create the correct Screen class, depending on the selected computer.
     string model = options["model"];
     if (isSpectrum(model)) {
@@ -176,9 +209,10 @@ void displayLicense() {
 void displayHelp() {
 
     cout << "Usage: SpecIde [options] [tapefiles] [diskfiles]" << endl;
+    cout << "       SpecIde --list [tapefiles]" << endl;
     cout << endl;
     cout << "Supported tape formats: TAP TZX PZX CDT CSW." << endl;
-    cout << "Supported disk formats: DSK." << endl;
+    cout << "Supported disk formats: DSK TRD SCL." << endl;
     cout << "Supported snap formats: Z80." << endl;
     cout << endl;
     cout << "Options:" << endl;
@@ -241,13 +275,30 @@ void displayHelp() {
     cout << "--nodoublescan         Single scan mode. (Default)" << endl;
     cout << "--sync                 Sync emulation to PC video refresh rate." << endl;
     cout << "                           (Use only with 50Hz video modes!)" << endl;
+    cout << "--headless             Run without window or sound, as fast as possible." << endl;
+    cout << "                           (Runs 'frames' frames from SpecIde.cfg, default 15000)" << endl;
     cout << endl;
     cout << "Sound options (add prefix 'no' to disable. Eg. --nosound):" << endl;
     cout << "--sound                Enable beeper/PSG sound. (Default)" << endl;
     cout << "--tapesound            Enable tape sound." << endl;
+    cout << "--lowlatency           Adapt sound buffering to the lowest stable latency." << endl;
+    cout << "--psgrec               Record PSG writes to a .psg file named after the first file." << endl;
+    cout << "--micrec               Record tape output to a file named after the first file." << endl;
+    cout << "                           (Format is 'micformat' from SpecIde.cfg: pzx, tzx, csw)" << endl;
     cout << endl;
     cout << "Emulation options (add prefix 'no' to disable. Eg. --noflashtap):" << endl;
     cout << "--flashtap         Enable ROM traps for LOAD and SAVE." << endl;
+    cout << "--flashdsk         Enable ROM traps for disk sector access." << endl;
+    cout << "--turbotape        Run at full speed while a tape is loading." << endl;
+    cout << "--edgeloops        Skip tape edge detection loop iterations at once." << endl;
+    cout << "--fastdisk         Complete disk seeks, searches and transfers at once." << endl;
+    cout << "--diskwrite        Write disk changes back to the DSK files." << endl;
+    cout << endl;
+    cout << "Disk drive options:" << endl;
+    cout << "--driveb <diskfile>    Insert a disk in drive B:. Other disk files go to drive A:." << endl;
+    cout << endl;
+    cout << "Tape options:" << endl;
+    cout << "--tapeblock <n>        Start the tape at block n, as numbered by --list." << endl;
     cout << endl;
 }
 
@@ -259,13 +310,24 @@ void readOptions(map<string, string>& options) {
     options["pad"] = "no";
     options["tapesound"] = "yes";
     options["sound"] = "yes";
+    options["lowlatency"] = "no";
+    options["psgrec"] = "no";
+    options["micrec"] = "no";
+    options["micformat"] = "pzx";
     options["forcepsg"] = "no";
     options["stereo"] = "none";
     options["psgtype"] = "ay";
     options["scanmode"] = "normal";
     options["fullscreen"] = "no";
     options["flashtap"] = "no";
+    options["flashdsk"] = "no";
+    options["turbotape"] = "no";
+    options["edgeloops"] = "no";
+    options["fastdisk"] = "no";
+    options["diskwrite"] = "no";
     options["sync"] = "no";
+    options["headless"] = "no";
+    options["frames"] = "15000";
     options["sd1"] = "no";
     options["scale"] = "1";
     options["z80type"] = "nmos";
@@ -332,6 +394,14 @@ void readOptions(map<string, string>& options) {
     }
 }
 
+void listTapes(vector<string> const& files) {
+
+    for (vector<string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+        Tape tape;
+        tape.listBlocks(*it);
+    }
+}
+
 bool isSpectrum(string const& model) {
 
     set<string> models = {
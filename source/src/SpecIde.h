@@ -30,6 +30,13 @@ void displayLicense();
  */
 void displayHelp();
 
+/**
+ * Print the block catalogue of each tape file.
+ *
+ * @param files Tape files to list.
+ */
+void listTapes(std::vector<std::string> const& files);
+
 /**
  * Get list of directories that will be searched for ROM files.
  *
@@ -42,6 +42,8 @@ void SpeccyScreen::setup() {
 
     spectrum.channel.open(2, SAMPLE_RATE);
     spectrum.channel.setSleepInterval(getNumber("soundsleep", 10));
+    spectrum.channel.adaptive = (options["lowlatency"] == "yes");
+    cout << "Low latency sound: " << options["lowlatency"] << endl;
 
     cout << "Initialising ZX Spectrum..." << endl;
     // Select ROMs and ULA variant.
@@ -171,6 +173,16 @@ void SpeccyScreen::setup() {
     // Other stuff.
     spectrum.flashTap = (options["flashtap"] == "yes");
     cout << "FlashTAP: " << options["flashtap"] << endl;
+    spectrum.edgeLoops = (options["edgeloops"] == "yes");
+    cout << "Edge loops: " << options["edgeloops"] << endl;
+    spectrum.flashDsk = (options["flashdsk"] == "yes");
+    cout << "FlashDSK: " << options["flashdsk"] << endl;
+    spectrum.fdc765.fastMode = (options["fastdisk"] == "yes");
+    spectrum.fd1793.fastMode = (options["fastdisk"] == "yes");
+    cout << "Fast disk: " << options["fastdisk"] << endl;
+    spectrum.fdc765.drive[0].writeBack = (options["diskwrite"] == "yes");
+    spectrum.fdc765.drive[1].writeBack = (options["diskwrite"] == "yes");
+    cout << "Disk write back: " << options["diskwrite"] << endl;
 
     if (options["sd1"] == "yes") {
         spectrum.idle = 0xDF;
@@ -208,13 +220,27 @@ void SpeccyScreen::setup() {
 
     xSize = ULA::X_SIZE;
     ySize = ULA::Y_SIZE / (doubleScanMode ? 1 : 2);
-    texture(xSize, ySize);
+    if (!headless) {
+        texture(xSize, ySize);
+    }
 
     loadFiles();
 
     wide = false;
-    reopenWindow(fullscreen);
-    setFullScreen(fullscreen);
+    if (headless) {
+        soundEnabled = false;
+    } else {
+        reopenWindow(fullscreen);
+        setFullScreen(fullscreen);
+    }
+
+    if (psgRecord) {
+        spectrum.psgRecorder.start();
+    }
+    if (micRecord) {
+        // The ULA is clocked at 7MHz.
+        spectrum.micRecorder.start(7000000.0, static_cast<uint32_t>(spectrum.ula.cycles));
+    }
     spectrum.ula.tapeSound = tapeSound;
     spectrum.ula.playSound = soundEnabled;
     spectrum.psgPlaySound(psgSound && soundEnabled);
@@ -241,16 +267,8 @@ void SpeccyScreen::loadFiles() {
                 break;
 
             case FileTypes::FILETYPE_DSK:
-                {
-                    DSKFile dsk;
-                    dsk.load(*it);
-
-                    if (dsk.validFile) {
-                        spectrum.fdc765.drive[0].images.push_back(dsk);
-                        spectrum.fdc765.drive[0].imageNames.push_back(*it);
-                        spectrum.fdc765.drive[0].disk = true;
-                    }
-                }
+            case FileTypes::FILETYPE_TRD:
+                loadDiskFile(*it, 0);
                 break;
 
             case FileTypes::FILETYPE_Z80:
@@ -280,10 +298,62 @@ void SpeccyScreen::loadFiles() {
                 break;
         }
     }
+
+    if (!options["driveb"].empty()) {
+        loadDiskFile(options["driveb"], 1);
+    }
+
+    if (!options["tapeblock"].empty()) {
+        spectrum.tape.seekBlock(getNumber("tapeblock", 0));
+    }
+}
+
+void SpeccyScreen::loadDiskFile(string const& fileName, size_t drive) {
+
+    switch (guessFileType(fileName)) {
+        case FileTypes::FILETYPE_DSK:
+            {
+                DSKFile const* dsk = loadDisk(fileName);
+                if (dsk) {
+                    spectrum.fdc765.drive[drive].addImage(*dsk, fileName);
+                }
+            }
+            break;
+
+        case FileTypes::FILETYPE_TRD:
+            {
+                // The extension is either .trd or .scl.
+                TRDFile trd;
+                string extension = fileName.substr(fileName.size() - 4);
+                if (tolower(extension[1]) == 's') {
+                    trd.loadSCL(fileName);
+                } else {
+                    trd.loadTRD(fileName);
+                }
+
+                if (trd.diskOk) {
+                    spectrum.fd1793.drive[drive].images.push_back(std::move(trd));
+                    spectrum.fd1793.drive[drive].imageNames.push_back(fileName);
+                    spectrum.fd1793.drive[drive].disk = true;
+                }
+            }
+            break;
+
+        default:
+            cout << "Not a disk image: " << fileName << endl;
+            break;
+    }
 }
 
 void SpeccyScreen::run() {
 
+    if (headless) {
+        for (uint32_t ii = 0; ii < headlessFrames; ++ii) {
+            spectrum.run();
+        }
+        done = true;
+    }
+
     while (!done) {
         Clock clock;
         Time frameTime = microseconds(spectrum.frame);
@@ -297,6 +367,12 @@ void SpeccyScreen::run() {
             // Run a complete frame.
             pollEvents();
             spectrum.run();
+
+            if (turboTape && spectrum.tape.loading()) {
+                runTurbo();
+                continue;
+            }
+
             if (spectrum.channel.commit()) {
                 spectrum.playSound(true);
             }
@@ -334,6 +410,32 @@ void SpeccyScreen::run() {
             }
         }
     }
+
+    if (psgRecord) {
+        spectrum.psgRecorder.save(psgRecordName());
+    }
+    if (micRecord) {
+        spectrum.micRecorder.save(micRecordName());
+    }
+    spectrum.fdc765.flush(true);
+}
+
+void SpeccyScreen::runTurbo() {
+
+    // Sound is muted, and the screen is updated only now and then.
+    Clock clock;
+    spectrum.playSound(false);
+    while (!done && !menu && spectrum.tape.loading()) {
+        spectrum.run();
+        if (clock.getElapsedTime() >= microseconds(TURBO_UPDATE_TIME)) {
+            clock.restart();
+            pollEvents();
+            update();
+        }
+    }
+
+    // Discard the samples generated during the turbo run.
+    spectrum.channel.wrSample = 0;
 }
 
 void SpeccyScreen::update() {
@@ -346,7 +448,7 @@ void SpeccyScreen::update() {
 
     if (spectrum.tape.pulseData.size()) {
         char str[64];
-        unsigned int percent = 100 * spectrum.tape.pointer / spectrum.tape.pulseData.size();
+        unsigned int percent = spectrum.tape.percent();
         snprintf(str, 64, "SpecIde [%s(%s)] [%03u%%]",
                 SPECIDE_BUILD_DATE, SPECIDE_BUILD_COMMIT, percent);
         window.setTitle(str);
@@ -439,22 +541,38 @@ void SpeccyScreen::close() {
 
 void SpeccyScreen::createEmptyDisk() {
 
-    spectrum.fdc765.drive[0].emptyDisk();
+    if (spectrum.betaDisk128) {
+        spectrum.fd1793.drive[0].emptyDisk();
+    } else {
+        spectrum.fdc765.drive[0].emptyDisk();
+    }
 }
 
 void SpeccyScreen::saveDisk() {
 
-    spectrum.fdc765.drive[0].saveDisk();
+    if (spectrum.betaDisk128) {
+        spectrum.fd1793.drive[0].saveDisk();
+    } else {
+        spectrum.fdc765.drive[0].saveDisk();
+    }
 }
 
 void SpeccyScreen::selectPreviousDisk() {
 
-    spectrum.fdc765.drive[0].prevDisk();
+    if (spectrum.betaDisk128) {
+        spectrum.fd1793.drive[0].prevDisk();
+    } else {
+        spectrum.fdc765.drive[0].prevDisk();
+    }
 }
 
 void SpeccyScreen::selectNextDisk() {
 
-    spectrum.fdc765.drive[0].nextDisk();
+    if (spectrum.betaDisk128) {
+        spectrum.fd1793.drive[0].nextDisk();
+    } else {
+        spectrum.fdc765.drive[0].nextDisk();
+    }
 }
 
 void SpeccyScreen::reset() {
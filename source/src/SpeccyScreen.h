@@ -77,6 +77,11 @@ class SpeccyScreen : public Screen {
          */
         void run();
 
+        /**
+         * Run the emulation unthrottled while the tape is loading.
+         */
+        void runTurbo();
+
         /**
          * Exit the ZX Spectrum emulation.
          */
@@ -92,6 +97,14 @@ class SpeccyScreen : public Screen {
          */
         void loadFiles();
 
+        /**
+         * Load a DSK, TRD or SCL file into a disk drive.
+         *
+         * @param fileName The image file.
+         * @param drive The drive, 0 for A: and 1 for B:.
+         */
+        void loadDiskFile(std::string const& fileName, size_t drive);
+
         /**
          * Update screen after each frame.
          */
@@ -251,6 +251,9 @@ void Spectrum::run() {
         if (flashTap) {
             checkTapeTraps();
         }
+        if (flashDsk) {
+            checkDiskTraps();
+        }
 
         clock();
 
@@ -274,6 +277,17 @@ void Spectrum::run() {
     }
 
     ula.vSync = false;
+
+    // Iterations never span frames, so the state can change in between.
+    loopState = EDGE_LOOP_IDLE;
+
+    if (psgRecorder.recording) {
+        psgRecorder.frame();
+    }
+    if (micRecorder.recording) {
+        micRecorder.frame(static_cast<uint32_t>(ula.cycles));
+    }
+    tape.frame();
 }
 
 void Spectrum::clock() {
@@ -360,25 +374,18 @@ void Spectrum::clock() {
     ++count;
 
     if (!(count & 0x03)) {
-        ula.beeper();
-        psgClock();
-
-        for (int c = 0; c < 4; ++c) {
-            filter[c].add(covox[c]);
-        }
-
-        if (joystick == JoystickType::FULLER) {
-            fullerCount += psgPeriod;
-            if (fullerCount > fullerPeriod) {
-                fullerCount -= fullerPeriod;
-                psg[4].clock();
-            }
+        // Only the sound sources present in this configuration are clocked.
+        for (size_t ii = 0; ii < numClockSources; ++ii) {
+            (this->*clockSources[ii])();
         }
     }
 
-    if (!(count % 0x07)) {
-        if (plus3Disk) fdc765.clock();
-        //if (betaDisk128) fd1793.clock();
+    // The FDC is clocked only while it has work to do.
+    if (plus3Disk && !fdc765.sleeping && !(count % 0x07)) {
+        fdc765.clock();
+    }
+    if (betaDisk128 && !fd1793.sleeping && !(count % 0x07)) {
+        fd1793.clock();
     }
 
     // Switch pages only if the ULA is not accessing memory.
@@ -389,6 +396,12 @@ void Spectrum::clock() {
 
     // We clock the Z80 if the ULA allows.
     if (ula.cpuClock) {
+        // The Z80 is held while skipped loop iterations elapse.
+        if (loopHold) {
+            --loopHold;
+            return;
+        }
+
         // Z80 gets data from the ULA or memory, only when reading.
         if (z80.access) {
             if (!io_) {
@@ -396,6 +409,7 @@ void Spectrum::clock() {
                     if (!(z80.a & 0x0001)) {
                         // ULA port read returns keypresses and EAR status.
                         z80.d = ula.ioRead();
+                        ++tape.reads;
                     } else {
                         // Unattached port read. On 48K/128K/Plus2, floating bus.
                         // Returns idle bus value by default, or video data,
@@ -486,14 +500,14 @@ void Spectrum::clock() {
                 // Common ports.
                 // Ports in the form XXXXXXXX 0XX11111 are blocked when TR-DOS
                 // is active. This affects kempston joystick, for instance.
-                if (betaDisk128 && (romBank == 0x0002)) {
+                if (betaDisk128 && trDos) {
                     if ((z80.a & 0x0003) == 0x0003) {
-                        // uint_fast8_t fdAddr = (z80.a & 0xE0) >> 5;
-                        // if (z80.rd) {
-                            // z80.d = fd1793.read(fdAddr);
-                        // } else if (z80.wr) {
-                            // fd1793.write(fdAddr, z80.d);
-                        // }
+                        uint_fast8_t fdAddr = (z80.a & 0xE0) >> 5;
+                        if (z80.rd) {
+                            z80.d = fd1793.read(fdAddr);
+                        } else if (z80.wr) {
+                            fd1793.write(fdAddr, z80.d);
+                        }
                     }
                 } else {
                     switch (joystick) {
@@ -515,17 +529,17 @@ void Spectrum::clock() {
                                 case 0x0030:
                                     // Port 0x003F, Fuller AY control port
                                     if (z80.wr) {
-                                        psg[4].addr(z80.d);
+                                        fuller.addr(z80.d);
                                     } else if (z80.rd) {
-                                        z80.d = psg[4].read();
+                                        z80.d = fuller.read();
                                     }
                                     break;
                                 case 0x0050:
                                     // Port 0x005F, Fuller AY data port
                                     if (z80.wr) {
-                                        psg[4].write(z80.d);
+                                        fuller.write(z80.d);
                                     } else if (z80.rd) {
-                                        z80.d = psg[4].read();
+                                        z80.d = fuller.read();
                                     }
                                     break;
                                 case 0x0070:
@@ -601,6 +615,9 @@ void Spectrum::clock() {
                 // an even address.
                 if (z80.wr && !(z80.a & 0x0001)) {
                     ula.ioWrite(z80.d);
+                    if (micRecorder.recording) {
+                        micRecorder.write(z80.d & 0x08, static_cast<uint32_t>(ula.cycles));
+                    }
                 }
             } else if (!as_) {
                 // BetaDisk128 pages TR-DOS ROM when the PC is in the range
@@ -610,8 +627,10 @@ void Spectrum::clock() {
                 if (betaDisk128 && z80.fetch) {
                     if ((romBank == 0x0001) && ((z80.a & 0xFF00) == 0x3D00)) {
                         setPage(0, 2, true, false);
-                    } else if (memArea) {
+                        trDos = true;
+                    } else if (memArea && trDos) {
                         setPage(0, romBank, true, false);
+                        trDos = false;
                     }
                 }
 
@@ -625,6 +644,14 @@ void Spectrum::clock() {
             z80.d = 0xFF;
         }
         z80.clock();
+
+        if (loopState == EDGE_LOOP_MEASURE) {
+            if (z80.state == Z80State::ST_OCF_T1H_ADDRWR) {
+                checkEdgeLoop();
+            }
+        } else if (edgeLoops && tape.playing && z80.state == Z80State::ST_OCF_T1H_ADDRWR) {
+            startEdgeLoop();
+        }
     }
 }
 
@@ -652,6 +679,7 @@ void Spectrum::updatePage() {
     setSnowPage((pageRegs & 0x0005) | screen);
 
     if (pageRegs & 0x0100) {      // Special pagination mode.
+        rom48 = false;              // All RAM, no ROM routines to trap.
         switch (pageRegs & 0x0600) {
             case 0x0000:
                 setPage(0, 0, false, false);
@@ -684,7 +712,8 @@ void Spectrum::updatePage() {
         ramBank = pageRegs & 0x0007;
         romBank = ((pageRegs & 0x0010) >> 4) | ((pageRegs & 0x0400) >> 9);
 
-        setPage(0, romBank, true, false);
+        // TR-DOS ROM stays paged until the PC leaves the ROM area.
+        setPage(0, trDos ? 2 : romBank, true, false);
         setPage(1, 5, false, true);
         setPage(2, 2, false, false);
         setPage(3, ramBank, false, ((ramBank & mask) == mask));
@@ -701,10 +730,12 @@ void Spectrum::reset() {
     z80.reset();
     psgReset();
     fdc765.reset();
+    fd1793.reset();
 
     covox[0] = covox[1] = covox[2] = covox[3] = 0;
     romBank = 0;
     ramBank = 0;
+    trDos = false;
     setPage(0, 0, true, false);
     setPage(1, 5, false, true);
     setPage(2, 2, false, false);
@@ -724,6 +755,8 @@ void Spectrum::reset() {
 
     snowMode = NONE;
     snowAddr = 0x0000;
+
+    updateSoundSources();
 }
 
 void Spectrum::psgSelect() {
@@ -731,152 +764,163 @@ void Spectrum::psgSelect() {
     size_t newPsg = (~z80.d) & 0x03;
     if (newPsg < psgChips) {
         currentPsg = newPsg;
-        psg[currentPsg].lchan = (z80.d & 0x40);
-        psg[currentPsg].rchan = (z80.d & 0x20);
+        psg.lchan[currentPsg] = (z80.d & 0x40);
+        psg.rchan[currentPsg] = (z80.d & 0x20);
+        psg.updateMix(currentPsg);
     }
 }
 
 void Spectrum::psgRead() {
 
     if (currentPsg < psgChips) {
-        z80.d = psg[currentPsg].read();
+        z80.d = psg.read(currentPsg);
     }
 }
 
 void Spectrum::psgWrite() {
 
     if (currentPsg < psgChips) {
-        psg[currentPsg].write(z80.d);
+        psg.write(currentPsg, z80.d);
+        if (psgRecorder.recording && currentPsg == 0) {
+            psgRecorder.write(psg.a[0], psg.r[0][psg.a[0] & 0x0F]);
+        }
     }
 }
 
 void Spectrum::psgAddr() {
 
     if (currentPsg < psgChips) {
-        psg[currentPsg].addr(z80.d);
+        psg.addr(currentPsg, z80.d);
     }
 }
 
 void Spectrum::psgReset() {
 
+    psg.chips = psgChips;
     for (size_t ii = 0; ii < psgChips; ++ii) {
-        psg[ii].reset();
-        psg[ii].seed = 0xFFFF - (ii * 0x1111);
+        psg.reset(ii);
+        psg.seed[ii] = 0xFFFF - (ii * 0x1111);
     }
 
     if (joystick == JoystickType::FULLER) {
-        psg[4].reset();
-        psg[4].seed = 0xFFFF - (4 * 0x1111);
+        fuller.reset();
+        fuller.seed = 0xFFFF - (4 * 0x1111);
     }
 }
 
 void Spectrum::psgClock() {
 
-    for (size_t ii = 0; ii < psgChips; ++ii) {
-        psg[ii].clock();
-    }
+    psg.clock();
 }
 
 void Spectrum::psgPlaySound(bool play) {
 
-    for (size_t ii = 0; ii < psgChips; ++ii) {
-        psg[ii].playSound = play;
-    }
+    psg.playSound = play;
 
     if (joystick == JoystickType::FULLER) {
-        psg[4].playSound = play;
+        fuller.playSound = play;
     }
+
+    updateSoundSources();
 }
 
 void Spectrum::psgSample() {
 
-    for (size_t ii = 0; ii < psgChips; ++ii) {
-        psg[ii].sample();
-    }
-
-    if (joystick == JoystickType::FULLER) {
-        psg[4].sample();
-    }
+    psg.sample();
 }
 
 void Spectrum::psgChip(bool aychip) {
 
-    for (size_t ii = 0; ii < psgChips; ++ii) {
-        psg[ii].setVolumeLevels(aychip);
-    }
+    psg.setVolumeLevels(aychip);
 
     if (joystick == JoystickType::FULLER) {
-        psg[4].setVolumeLevels(aychip);
+        fuller.setVolumeLevels(aychip);
     }
 }
 
 void Spectrum::sample() {
 
-    int l = ula.sample();
-    int r = l;
-    l += dac(0) + dac(1);
-    r += dac(2) + dac(3);
+    int l = 0;
+    int r = 0;
+
+    for (size_t ii = 0; ii < numMixSources; ++ii) {
+        (this->*mixSources[ii])(l, r);
+    }
+
+    channel.push(l, r);
+}
+
+void Spectrum::psgMix(int& l, int& r) {
+
     psgSample();
+    psg.mix(l, r);
+}
 
-    if (joystick == JoystickType::FULLER) {
-        l -= psg[4].channelA + psg[4].channelB + psg[4].channelC;
-        r -= psg[4].channelA + psg[4].channelB + psg[4].channelC;
+void Spectrum::fullerClock() {
+
+    fullerCount += psgPeriod;
+    if (fullerCount > fullerPeriod) {
+        fullerCount -= fullerPeriod;
+        fuller.clock();
     }
+}
 
-    switch (stereo) {
-        case StereoMode::STEREO_ACB: // ACB
-            l -= psg[0].channelA + psg[0].channelC;
-            r -= psg[0].channelB + psg[0].channelC;
-            break;
+void Spectrum::fullerMix(int& l, int& r) {
 
-        case StereoMode::STEREO_ABC: // ABC
-            l -= psg[0].channelA + psg[0].channelB;
-            r -= psg[0].channelB + psg[0].channelC;
-            break;
+    fuller.sample();
+    l -= fuller.channelA + fuller.channelB + fuller.channelC;
+    r -= fuller.channelA + fuller.channelB + fuller.channelC;
+}
 
-        case StereoMode::STEREO_TURBO_MONO: // TurboSound with 2 PSGs, mono.
-            l -= psg[0].channelA + psg[0].channelB + psg[0].channelC;
-            l -= psg[1].channelA + psg[1].channelB + psg[1].channelC;
-            r -= psg[0].channelA + psg[0].channelB + psg[0].channelC;
-            r -= psg[1].channelA + psg[1].channelB + psg[1].channelC;
-            break;
+void Spectrum::beeperMix(int& l, int& r) {
 
-        case StereoMode::STEREO_TURBO_ACB:  // TurboSound with 2 PSGs, ACB
-            l -= psg[0].channelA + psg[0].channelC;
-            l -= psg[1].channelA + psg[1].channelC;
-            r -= psg[0].channelB + psg[0].channelC;
-            r -= psg[1].channelB + psg[1].channelC;
-            break;
+    int level = ula.sample();
+    l += level;
+    r += level;
+}
 
-        case StereoMode::STEREO_TURBO_ABC: // TurboSound with 2 PSGs, ABC
-            l -= psg[0].channelA + psg[0].channelB;
-            l -= psg[1].channelA + psg[1].channelB;
-            r -= psg[0].channelB + psg[0].channelC;
-            r -= psg[1].channelB + psg[1].channelC;
-            break;
+void Spectrum::covoxClock() {
 
-        case StereoMode::STEREO_NEXT:
-            for (size_t ii = 0; ii < 4; ++ii) {
-                if (psg[ii].lchan) {
-                    l -= psg[ii].channelA >> 1;
-                    l -= psg[ii].channelB >> 1;
-                    l -= psg[ii].channelC >> 1;
-                }
-                if (psg[ii].rchan) {
-                    r -= psg[ii].channelA >> 1;
-                    r -= psg[ii].channelB >> 1;
-                    r -= psg[ii].channelC >> 1;
-                }
-            }
-            break;
+    for (int c = 0; c < 4; ++c) {
+        filter[c].add(covox[c]);
+    }
+}
 
-        default:    // mono, all channels go through both sides.
-            l -= psg[0].channelA + psg[0].channelB + psg[0].channelC;
-            r -= psg[0].channelA + psg[0].channelB + psg[0].channelC;
-            break;
+void Spectrum::covoxMix(int& l, int& r) {
+
+    l += dac(0) + dac(1);
+    r += dac(2) + dac(3);
+}
+
+void Spectrum::updateSoundSources() {
+
+    // Pick up the beeper level, in case its sound flags changed.
+    ula.beeper();
+
+    numClockSources = 0;
+    numMixSources = 0;
+
+    if (ula.playSound) {
+        // The beeper is integrated from its level changes, no clock needed.
+        mixSources[numMixSources++] = &Spectrum::beeperMix;
     }
 
-    channel.push(l, r);
+    if (covoxMode != Covox::NONE) {
+        clockSources[numClockSources++] = &Spectrum::covoxClock;
+        mixSources[numMixSources++] = &Spectrum::covoxMix;
+    }
+
+    psg.chips = psgChips;
+    psg.setStereo(stereo);
+    if (psgChips && psg.playSound) {
+        clockSources[numClockSources++] = &Spectrum::psgClock;
+        mixSources[numMixSources++] = &Spectrum::psgMix;
+    }
+
+    if (joystick == JoystickType::FULLER && fuller.playSound) {
+        clockSources[numClockSources++] = &Spectrum::fullerClock;
+        mixSources[numMixSources++] = &Spectrum::fullerMix;
+    }
 }
 
 int Spectrum::dac(size_t c) {
@@ -927,6 +971,154 @@ void Spectrum::checkTapeTraps() {
     }
 }
 
+void Spectrum::checkDiskTraps() {
+
+    // The DOS ROM is ROM 2, in normal pagination mode.
+    if (plus3Disk && romBank == 2 && !(pageRegs & 0x0100)
+            && (z80.state == Z80State::ST_OCF_T4L_RFSH2)) {
+        // The jump table entries are JP instructions to the routines.
+        uint8_t const* dos = &rom[2 * (1 << 14)];
+        uint_fast16_t read = dos[DD_READ_SECTOR + 1] | (dos[DD_READ_SECTOR + 2] << 8);
+        uint_fast16_t write = dos[DD_WRITE_SECTOR + 1] | (dos[DD_WRITE_SECTOR + 2] << 8);
+
+        if (dos[DD_READ_SECTOR] == 0xC3 && z80.pc.w == read + 1) {
+            trapDdSector(false);
+        } else if (dos[DD_WRITE_SECTOR] == 0xC3 && z80.pc.w == write + 1) {
+            trapDdSector(true);
+        }
+    }
+}
+
+bool Spectrum::isEdgeLoop(uint_fast16_t addr) {
+
+    uint_fast8_t first = readMemory(addr);
+    if (first != 0x04 && first != 0x05) {  // INC B / DEC B
+        return false;
+    }
+
+    uint_fast8_t retNc = readMemory(addr + 7);
+    return readMemory(addr + 1) == 0xC8     // RET Z
+        && readMemory(addr + 2) == 0x3E     // LD A,n
+        && readMemory(addr + 4) == 0xDB     // IN A,($FE)
+        && readMemory(addr + 5) == 0xFE
+        && readMemory(addr + 6) == 0x1F     // RRA
+        && (retNc == 0xD0 || retNc == 0x00) // RET NC / NOP
+        && readMemory(addr + 8) == 0xA9     // XOR C
+        && readMemory(addr + 9) == 0xE6     // AND n
+        && readMemory(addr + 11) == 0x28    // JR Z,loop
+        && readMemory(addr + 12) == 0x100 - EDGE_LOOP_SIZE;
+}
+
+void Spectrum::startEdgeLoop() {
+
+    loopState = EDGE_LOOP_IDLE;
+
+    // Interrupts would break the loop, and snow depends on R. The Z80 is
+    // held with the loop address on the bus, which must not be contended.
+    if ((z80.iff & IFF1) || !ula.tapePlaying
+            || contendedPage[z80.ir.b.h >> 6] || contendedPage[z80.pc.w >> 14]
+            || !isEdgeLoop(z80.pc.w)) {
+        return;
+    }
+
+    loopHead = z80.pc.w;
+    loopPort = (readMemory(loopHead + 3) << 8) | 0x00FE;
+    loopIn = edgeLoopPort();
+    loopPulse = tape.pointer;
+    loopStartB = z80.bc.b.h;
+    loopStartR = z80.ir.b.l;
+    loopCycle = ula.cycles;
+    loopRegs = edgeLoopRegisters();
+    loopState = EDGE_LOOP_MEASURE;
+}
+
+void Spectrum::checkEdgeLoop() {
+
+    if (z80.pc.w != loopHead) {
+        // Stop if the loop has exited.
+        if (((z80.pc.w - loopHead) & 0xFFFF) >= EDGE_LOOP_SIZE) {
+            loopState = EDGE_LOOP_IDLE;
+        }
+        return;
+    }
+
+    // A whole iteration has run. The next ones are the same if it ends as
+    // it started, no edge has come, and it was not contended.
+    uint_fast32_t clocks = EDGE_LOOP_CLOCKS - (readMemory(loopHead + 7) ? 0 : 2);
+    if (ula.cycles - loopCycle == clocks
+            && tape.pointer == loopPulse
+            && edgeLoopPort() == loopIn
+            && edgeLoopRegisters() == loopRegs
+            && skipEdgeLoop(clocks)) {
+        return;
+    }
+
+    // Check the next iteration instead.
+    startEdgeLoop();
+}
+
+bool Spectrum::skipEdgeLoop(uint_fast32_t clocks) {
+
+    uint_fast8_t b = z80.bc.b.h;
+    uint_fast8_t stepB = (b - loopStartB) & 0xFF;
+    uint_fast8_t stepR = (z80.ir.b.l - loopStartR) & 0x7F;
+
+    // The iteration where B reaches zero runs normally.
+    uint_fast32_t iterations;
+    if (stepB == 0x01) {
+        iterations = 0xFF - b;
+    } else if (stepB == 0xFF) {
+        iterations = (b ? b : 0x100) - 1;
+    } else {
+        return false;
+    }
+
+    // No tape edge can come before the last skipped iteration reads the
+    // port.
+    iterations = min(iterations, static_cast<uint_fast32_t>(tape.sample) / clocks);
+
+    // Keys change when the scan wraps, and the frame must end as usual.
+    // 48K and 128K ULAs contend I/O in the display lines.
+    if (!spectrumPlus2A && !pentagon && ula.scan < ula.vBorderStart) {
+        return false;
+    }
+    uint_fast32_t end = (ula.scan < ula.vSyncEnd) ? ula.vSyncEnd : ula.maxScan;
+    uint_fast32_t window = (end - ula.scan - 1) * ula.checkPointValues[ula.ulaVersion][5];
+    iterations = min(iterations, window / clocks);
+
+    if (!iterations) {
+        return false;
+    }
+
+    z80.bc.b.h = (b + iterations * stepB) & 0xFF;
+    z80.ir.b.l = (z80.ir.b.l & 0x80) | ((z80.ir.b.l + iterations * stepR) & 0x7F);
+    tape.reads += static_cast<uint32_t>(iterations);
+
+    loopHold = iterations * clocks;
+    loopStartB = z80.bc.b.h;
+    loopStartR = z80.ir.b.l;
+    loopCycle = ula.cycles + loopHold;
+    return true;
+}
+
+array<uint_fast16_t, EDGE_LOOP_REGS> Spectrum::edgeLoopRegisters() const {
+
+    return {z80.pc.w, z80.sp.w, z80.ix.w, z80.iy.w,
+        z80.af.w, z80.af_.w, z80.bc.b.l, z80.bc_.w,
+        z80.de.w, z80.de_.w, z80.hl.w, z80.hl_.w,
+        z80.wz.w, z80.wz_.w, static_cast<uint_fast16_t>(z80.ir.w & 0xFF80),
+        z80.iff, z80.im, z80.q};
+}
+
+uint_fast8_t Spectrum::edgeLoopPort() {
+
+    uint_fast16_t a = ula.z80_a;
+    ula.z80_a = loopPort;
+    uint_fast8_t byte = ula.ioRead();
+    ula.z80_a = a;
+    return byte;
+}
+
 void Spectrum::writeMemory(uint_fast16_t a, uint_fast8_t d) {
 
     a &= 0xFFFF;
@@ -1042,6 +1234,80 @@ void Spectrum::trapSaBytes() {
     z80.startInstruction();
 }
 
+void Spectrum::trapDdSector(bool write) {
+
+    // C is the unit. If there is no disk, the DOS routine reports it.
+    Plus3Disk& drive = fdc765.drive[z80.bc.b.l & 0x01];
+    if (!drive.disk || (write && drive.writeprot)) {
+        return;
+    }
+
+    // D is the logical track and E the logical sector, which are
+    // translated with the XDPB at IX.
+    uint_fast16_t xdpb = z80.ix.w;
+    size_t tracks = readMemory(xdpb + 18);
+    size_t cylinder = z80.de.b.h;
+    size_t head = 0;
+    switch (readMemory(xdpb + 17) & 0x03) {
+        case 1:     // Double sided, alternate.
+            cylinder = z80.de.b.h >> 1;
+            head = z80.de.b.h & 0x01;
+            break;
+        case 2:     // Double sided, successive.
+            if (cylinder >= tracks) {
+                cylinder -= tracks;
+                head = 1;
+            }
+            break;
+        default:
+            break;
+    }
+    uint_fast8_t id = z80.de.b.l + readMemory(xdpb + 20);
+    size_t length = 0x80 << (readMemory(xdpb + 15) & 0x07);
+
+    // Sectors with errors are left to the DOS routine and the FDC.
+    DSKFile::Track::Sector* sector = drive.findSector(cylinder, head, id);
+    if (!sector || sector->dataSize < length) {
+        return;
+    }
+
+    // The buffer is at HL. On $C000-$FFFF, it is in RAM page B.
+    uint_fast16_t address = z80.hl.w;
+    if (address < 0x4000 || address + length > 0x10000) {
+        return;
+    }
+    auto buffer = [&](size_t ii) -> uint8_t& {
+        uint_fast16_t a = address + ii;
+        return (a & 0xC000) == 0xC000
+            ? ram[(z80.bc.b.h & 0x07) * (1 << 14) + (a & 0x3FFF)]
+            : mem[a >> 14][a & 0x3FFF];
+    };
+
+    DSKFile& image = drive.images[drive.currentImage];
+    DSKSpan data = image.sectorData(*sector);
+    if (write) {
+        vector<uint8_t> bytes(data.begin(), data.end());
+        for (size_t ii = 0; ii < length; ++ii) {
+            bytes[ii] = buffer(ii);
+        }
+        image.store(*sector, bytes.data(), bytes.size());
+
+        // The FDC does not run, so it would not write the sector back.
+        fdc765.flush(false);
+    } else {
+        for (size_t ii = 0; ii < length; ++ii) {
+            buffer(ii) = data.data[ii];
+        }
+    }
+
+    // Carry set means success.
+    z80.af.b.l |= FLAG_C;
+
+    // Force RET
+    z80.decode(0xC9);
+    z80.startInstruction();
+}
+
 void Spectrum::setSoundRate(SoundRate rate, bool syncToVideo) {
 
     double value = 0;
@@ -1203,20 +1469,26 @@ void Spectrum::loadState(SaveState const& state) {
 
         if (state.emuFuller) {
             for (size_t ii = 0; ii < 16; ++ii) {
-                psg[4].r[ii] = state.ayRegs[ii];
+                fuller.r[ii] = state.ayRegs[ii];
             }
         } else {
             joystick = state.joystick;
         }
 
         if (state.emuAy8912) {
+            // Registers are written as the CPU would, so the periods,
+            // mixer, volumes and envelope follow them.
             for (size_t ii = 0; ii < 16; ++ii) {
-                psg[0].r[ii] = state.ayRegs[ii];
+                psg.addr(0, static_cast<uint_fast8_t>(ii));
+                psg.write(0, state.ayRegs[ii]);
             }
+            psg.addr(0, state.port_0xfffd);
         }
 
         z80.pc.w = state.pc;
         z80.state = Z80State::ST_OCF_T1H_ADDRWR;
     }
+
+    updateSoundSources();
 }
 // vim: et:sw=4:ts=4
@@ -19,9 +19,12 @@
 #include "Z80.h"
 #include "Z80Defs.h"
 #include "PSG.h"
+#include "PSGBank.h"
+#include "PSGRecorder.h"
 #include "FDC765.h"
-//#include "FD1793.h"
+#include "FD1793.h"
 #include "Tape.h"
+#include "TapeRecorder.h"
 
 #include "CommonDefs.h"
 #include "SaveState.h"
@@ -30,6 +33,7 @@
 
 #include "config.h"
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -45,6 +49,22 @@ enum class Covox {
     NONE
 };
 
+/** +3DOS jump table entries. */
+uint_fast16_t constexpr DD_READ_SECTOR = 0x0163;
+uint_fast16_t constexpr DD_WRITE_SECTOR = 0x0166;
+
+/** Edge loop accelerator states. */
+uint_fast8_t constexpr EDGE_LOOP_IDLE = 0;
+uint_fast8_t constexpr EDGE_LOOP_MEASURE = 1;
+uint_fast8_t constexpr EDGE_LOOP_HOLD = 2;
+
+/** Length of the recognised loops, in bytes. */
+uint_fast16_t constexpr EDGE_LOOP_SIZE = 13;
+/** Length of an uncontended iteration, in clocks (two per T-state). */
+uint_fast32_t constexpr EDGE_LOOP_CLOCKS = 2 * 59;
+/** Z80 registers that must not change in an iteration. */
+size_t constexpr EDGE_LOOP_REGS = 18;
+
 /**
  * A ZX Spectrum computer.
  *
@@ -81,17 +101,45 @@ class Spectrum {
         /** ULA. Supports Sinclair ULAs, Amstrad Gate Array, and Pentagon ULA. */
         ULA ula;
         /** PSG instances. (AY-8912-3, YM-2149) */
-        PSG psg[5];
+        PSGBank psg;
+        /** Fuller Box PSG. */
+        PSG fuller;
+        /** PSG register write recorder. Records the first PSG only. */
+        PSGRecorder psgRecorder;
         /** ZX Spectrum +3 floppy disk controller. (NEC765 or compatible.) */
         FDC765 fdc765;
         /** BetaDisk 128 floppy disk controller. (WD1793 or compatible.) */
-        //FD1793 fd1793;
+        FD1793 fd1793;
         /** Tape player. */
         Tape tape;
+        /** Tape output (MIC) recorder. */
+        TapeRecorder micRecorder;
 
         /** Sound channel object. */
         SoundChannel channel;
 
+        /** Accelerate tape edge detection loops. */
+        bool edgeLoops = false;
+        /** Edge loop accelerator state. */
+        uint_fast8_t loopState = EDGE_LOOP_IDLE;
+        /** Address of the first instruction of the loop. */
+        uint_fast16_t loopHead = 0x0000;
+        /** Port read by the loop. */
+        uint_fast16_t loopPort = 0x00FE;
+        /** Value read from the port when the iteration started. */
+        uint_fast8_t loopIn = 0xFF;
+        /** Values of B and R when the iteration started. */
+        uint_fast8_t loopStartB = 0;
+        uint_fast8_t loopStartR = 0;
+        /** Tape pulse when the iteration started. */
+        size_t loopPulse = 0;
+        /** ULA cycle when the iteration started. */
+        uint_fast32_t loopCycle = 0;
+        /** CPU clocks left while skipped iterations elapse. */
+        uint_fast32_t loopHold = 0;
+        /** Z80 registers when the iteration started, except B and R. */
+        array<uint_fast16_t, EDGE_LOOP_REGS> loopRegs;
+
         /** Byte in bus. Used in floating bus effects. */
         uint_fast8_t bus = 0xFF;
         /** Byte in gate array latch. Used in +2A/+3 "floating bus". */
@@ -117,8 +165,12 @@ class Spectrum {
         bool plus3Disk = false;
         /** Emulate BetaDisk128 disk interface. */
         bool betaDisk128 = false;
+        /** TR-DOS ROM is paged in. BetaDisk128 ports are active. */
+        bool trDos = false;
         /** Trap ROM tape routine. */
         bool flashTap = false;
+        /** Trap +3DOS sector routines. */
+        bool flashDsk = false;
         /** Emulate so many PSGs. */
         size_t psgChips = 0;
         /** Currently selected PSG. */
@@ -151,6 +203,15 @@ class Spectrum {
         /** Sync frame rate to monitor's 50Hz frame rate. */
         bool sync = false;
 
+        /** Active sound sources, clocked every 4 cycles. */
+        void (Spectrum::*clockSources[4])();
+        /** Active sound sources, mixed on each sample. */
+        void (Spectrum::*mixSources[4])(int& l, int& r);
+        /** Number of active sound sources that need a clock. */
+        size_t numClockSources = 0;
+        /** Number of active sound sources. */
+        size_t numMixSources = 0;
+
         /**
          * Map of contended memory areas. Typically, $4000-$7FFF is contended,
          * and $C000-$FFFF might be, but +2A/+3's special pagination mode allows other
@@ -372,6 +433,57 @@ class Spectrum {
          */
         void psgSample();
 
+        /**
+         * Mix the PSG channels, according to the stereo mode.
+         *
+         * @param l Left channel sample.
+         * @param r Right channel sample.
+         */
+        void psgMix(int& l, int& r);
+
+        /**
+         * Clock the Fuller Box PSG.
+         */
+        void fullerClock();
+
+        /**
+         * Sample and mix the Fuller Box PSG.
+         *
+         * @param l Left channel sample.
+         * @param r Right channel sample.
+         */
+        void fullerMix(int& l, int& r);
+
+        /**
+         * Sample and mix the ULA beeper.
+         *
+         * @param l Left channel sample.
+         * @param r Right channel sample.
+         */
+        void beeperMix(int& l, int& r);
+
+        /**
+         * Clock the Covox filters.
+         */
+        void covoxClock();
+
+        /**
+         * Sample and mix the Covox channels.
+         *
+         * @param l Left channel sample.
+         * @param r Right channel sample.
+         */
+        void covoxMix(int& l, int& r);
+
+        /**
+         * Rebuild the list of active sound sources.
+         *
+         * This must be called whenever the sound configuration changes
+         * (number of PSGs, Fuller Box, Covox mode, sound enabled), so
+         * disabled hardware is neither clocked nor mixed.
+         */
+        void updateSoundSources();
+
         /**
          * Select PSG type.
          *
@@ -401,6 +513,68 @@ class Spectrum {
          */
         void checkTapeTraps();
 
+        /**
+         * Check if the +3 is about to execute the +3DOS sector routines.
+         *
+         * The routines are found through the +3DOS jump table, so the trap
+         * works with any DOS ROM version.
+         */
+        void checkDiskTraps();
+
+        /**
+         * Check if the Z80 is at the start of a tape edge detection loop,
+         * like the ROM LD-SAMPLE:
+         *
+         *      INC B (or DEC B)
+         *      RET Z
+         *      LD A,n
+         *      IN A,($FE)
+         *      RRA
+         *      RET NC (or NOP)
+         *      XOR C
+         *      AND n
+         *      JR Z,loop
+         *
+         * @param addr Address of the first instruction.
+         */
+        bool isEdgeLoop(uint_fast16_t addr);
+
+        /**
+         * Start an iteration of an edge detection loop.
+         *
+         * The loop is recognised when an instruction starts. One iteration
+         * runs normally. If it leaves all registers but B and R unchanged,
+         * and takes as long as an uncontended one, the iterations that
+         * finish before the next tape edge are skipped at once.
+         */
+        void startEdgeLoop();
+
+        /**
+         * Check the iteration that has just finished, and skip the next
+         * ones if it can be repeated.
+         */
+        void checkEdgeLoop();
+
+        /**
+         * Skip iterations at once. B and R are updated, and the Z80 is held
+         * for the time the iterations take. The rest of the computer is
+         * still clocked, so the T-state count is exact.
+         *
+         * @param clocks Length of an iteration, in clocks.
+         * @return True if any iteration was skipped.
+         */
+        bool skipEdgeLoop(uint_fast32_t clocks);
+
+        /**
+         * Get the Z80 registers that must not change in an iteration.
+         */
+        array<uint_fast16_t, EDGE_LOOP_REGS> edgeLoopRegisters() const;
+
+        /**
+         * Read the port read by the loop.
+         */
+        uint_fast8_t edgeLoopPort();
+
         /**
          * Write a memory byte using the 64KB map.
          *
@@ -427,6 +601,12 @@ class Spectrum {
          */
         void trapSaBytes();
 
+        /**
+         * Trap DD READ SECTOR or DD WRITE SECTOR, and copy the sector
+         * between the disk image and memory.
+         */
+        void trapDdSector(bool write);
+
         void loadState(SaveState const& state);
 };
 // vim: et:sw=4:ts=4
@@ -16,21 +16,16 @@
 #include "TAPFile.h"
 
 void TAPFile::load(string const& fileName) {
-    char c;
 
-    ifstream ifs(fileName.c_str(), ifstream::binary);
-    if (ifs.good()) {
-        fileData.clear();
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
+    if (!fileData.open(fileName)) {
+        cout << "Cannot open file: " << fileName << endl;
     }
 
     name = fileName;
 }
 
 void TAPFile::parse(
-        vector<uint32_t> &pulseData,
+        PulseData& pulseData,
         set<size_t> &indexData,
         set<size_t> &stopData) {
 
@@ -50,6 +45,7 @@ void TAPFile::parse(
     // Parse data from the beginning. Do not erase previous pulseData, so
     // multiple tapes can be concatenated.
     pointer = 0;
+    blocks.clear();
     if (pulseData.size()) {
         indexData.insert(pulseData.size());
         stopData.insert(pulseData.size());
@@ -73,9 +69,15 @@ void TAPFile::parse(
         cout << "Flag: " << static_cast<size_t>(flagByte) << "  ";
         cout << "Length: " << dataLength << endl;
 
+        // The FlashTAP data is a copy of the file.
+        TapeBlock block;
+        block.type = TAPE_BLOCK_STANDARD;
+        block.start = pulseData.size();
+        block.data = pointer;
+        block.identify(fileData.data() + pointer + 2, dataLength);
+
         // Insert the pilot tone.
-        pulseData.insert(pulseData.end(),
-                (flagByte & 0x80) ? PILOT_DATA_LENGTH : PILOT_HEAD_LENGTH,
+        pulseData.append((flagByte & 0x80) ? PILOT_DATA_LENGTH : PILOT_HEAD_LENGTH,
                 PILOT_PULSE);
 
         // Insert the sync pulses.
@@ -86,8 +88,7 @@ void TAPFile::parse(
         for (size_t ii = 0; ii < dataLength; ++ii) {
             byte = fileData[pointer + 2 + ii];
             for (size_t jj = 0; jj < 8; ++jj) {
-                pulseData.insert(pulseData.end(),
-                        2, (byte & 0x80) ? DATA_PULSE_1 : DATA_PULSE_0);
+                pulseData.append(2, (byte & 0x80) ? DATA_PULSE_1 : DATA_PULSE_0);
                 byte <<= 1;
             }
         }
@@ -97,6 +98,8 @@ void TAPFile::parse(
         pulseData.push_back(MILLISECOND_PAUSE);
         pulseData.push_back(MILLISECOND_PAUSE * 1000);
         indexData.insert(pulseData.size());
+        block.end = pulseData.size();
+        blocks.push_back(block);
 
         pointer += dataLength + 2;
     }
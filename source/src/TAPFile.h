@@ -22,6 +22,10 @@
 #include <string>
 #include <vector>
 
+#include "FileView.h"
+#include "PulseData.h"
+#include "TapeBlock.h"
+
 using namespace std;
 
 /** TAPFile.h
@@ -34,13 +38,14 @@ using namespace std;
 class TAPFile
 {
     public:
-        vector<uint8_t> fileData;
+        FileView fileData;
+        vector<TapeBlock> blocks;   // Block catalogue.
 
         TAPFile() {}
 
         void load(string const& fileName);
         void parse(
-                vector<uint32_t> &pulseData,
+                PulseData& pulseData,
                 set<size_t> &indexData,
                 set<size_t> &stopData);
 
@@ -25,29 +25,19 @@ using namespace std;
 
 void TRDFile::loadTRD(string const& fileName) {
 
-    ifstream ifs(fileName.c_str(), ios::binary);
-    if (ifs.good()) {
-        diskData.clear();
-
-        char c;
-        while (ifs.get(c)) {
-            diskData.push_back(c);
-        }
+    // The disk can be written, so it needs its own copy.
+    if (fileData.open(fileName)) {
+        diskData.assign(fileData.begin(), fileData.end());
+        fileData.close();
     }
 
     // TR-DOS disks are 256 BPS, 16 SPT. Info of geometry is in track 0.
-    // Disk Info Block must be at least 0x100 bytes long.
     // File descriptors are in h0t0s1 to h0t0s8.
     // Disk info is in h0t0s9. The rest of h0t0 is unused.
     // The file should have at least 9 sectors, that is, 256 * 9 bytes.
-    if (diskData.size() < 0x900) {
-        return;
-    }
-
-    // First byte of disk info is 0x00 (end of catalogue)
-    // Byte at offset 0xE7 is 0x10 (TR-DOS ID)
-    if (diskData[0x900] == 0 || diskData[0x9E7] == 0x10) {
-        diskType = diskData[0x9E3];
+    diskOk = false;
+    if (diskData.size() >= TRD_INFO + TRD_SECTOR_SIZE) {
+        diskType = diskData[TRD_INFO + 0xE3];
 
         switch (diskType) {
             case 0x16:
@@ -75,41 +65,135 @@ void TRDFile::loadTRD(string const& fileName) {
                 break;
 
             default:
-                break;;
+                break;
         }
     }
 
     if (diskOk) {
-        diskData.resize(0x1000 * numTracks * numSides);
-        freeSpaceAddress[0] = diskData[0x9E1];
-        freeSpaceAddress[1] = diskData[0x9E2];
-        numFiles = diskData[0x9E4];
-        numFreeSectors = diskData[0x9E5] * 0x100 + diskData[0x9E6];
-        numDeleted = diskData[0x9F4];
-        copy(&diskData[0x9F5], &diskData[0x9FC], &diskLabel[0]);
+        // Some images have a few more tracks than the disk type says, and
+        // many are truncated after the last used track.
+        size_t tracks = (diskData.size() + numSides * TRD_TRACK_SIZE - 1)
+            / (numSides * TRD_TRACK_SIZE);
+        numTracks = max<size_t>(numTracks, min<size_t>(tracks, 86));
+        diskData.resize(TRD_TRACK_SIZE * numTracks * numSides);
+        readDiskInfo();
     } else {
+        diskData.clear();
         cout << fileName << ": Not a valid TRD image file." << endl;
     }
 }
 
 void TRDFile::loadSCL(string const& fileName) {
 
-    ifstream ifs(fileName.c_str(), ios::binary);
-    if (ifs.good()) {
-        fileData.clear();
+    fileData.open(fileName);
+
+    sclMagicOk = fileData.size() >= 0x09
+        && equal(&sclMagic[0x00], &sclMagic[0x08], fileData.begin());
+
+    diskOk = false;
+    if (sclMagicOk) {
+        // The magic is followed by the number of files, the file headers,
+        // and the data of the files, in whole sectors.
+        size_t files = fileData[8];
+        size_t header = 0x09;
+        size_t data = header + 14 * files;
+
+        makeEmpty();
+
+        size_t track = 1;
+        size_t sector = 0;
+        for (size_t ii = 0; ii < files && ii < 128; ++ii, header += 14) {
+            if (data > fileData.size()) {
+                break;
+            }
+
+            size_t sectors = fileData[header + 13];
+            size_t bytes = sectors * TRD_SECTOR_SIZE;
+            size_t offset = (track * TRD_SECTORS + sector) * TRD_SECTOR_SIZE;
+            if (data + bytes > fileData.size() || offset + bytes > diskData.size()) {
+                break;
+            }
+
+            // The catalogue entry is the SCL header, plus the position.
+            uint8_t* entry = &diskData[ii * 0x10];
+            copy(fileData.begin() + header, fileData.begin() + header + 14, entry);
+            entry[14] = static_cast<uint8_t>(sector);
+            entry[15] = static_cast<uint8_t>(track);
+
+            copy(fileData.begin() + data, fileData.begin() + data + bytes,
+                    diskData.begin() + offset);
+            data += bytes;
 
-        char c;
-        while (ifs.get(c)) {
-            fileData.push_back(c);
+            sector += sectors;
+            track += sector / TRD_SECTORS;
+            sector %= TRD_SECTORS;
+
+            ++diskData[TRD_INFO + 0xE4];
+            numFreeSectors -= static_cast<uint_fast16_t>(sectors);
         }
+
+        diskData[TRD_INFO + 0xE1] = static_cast<uint8_t>(sector);
+        diskData[TRD_INFO + 0xE2] = static_cast<uint8_t>(track);
+        diskData[TRD_INFO + 0xE5] = numFreeSectors & 0xFF;
+        diskData[TRD_INFO + 0xE6] = numFreeSectors >> 8;
+        readDiskInfo();
+    } else {
+        cout << fileName << ": Not a valid SCL image file." << endl;
     }
 
-    sclMagicOk = equal(&sclMagic[0x00], &sclMagic[0x08], fileData.begin());
+    fileData.close();
+}
+
+bool TRDFile::save(string const& fileName) {
 
-    if (sclMagicOk) {
-        numFiles = fileData[9];
+    ofstream ofs(fileName.c_str(), ios::binary);
+    if (ofs.good()) {
+        ofs.write(reinterpret_cast<char const*>(diskData.data()), diskData.size());
     }
+    return ofs.good();
+}
+
+void TRDFile::makeEmpty() {
+
+    numTracks = 80;
+    numSides = 2;
+    diskType = 0x16;
+    diskData.assign(TRD_TRACK_SIZE * numTracks * numSides, 0x00);
+
+    // The free space starts on track 1. Track 0 holds the catalogue.
+    uint_fast16_t free = (numTracks * numSides - 1) * TRD_SECTORS;
+    diskData[TRD_INFO + 0xE1] = 0x00;
+    diskData[TRD_INFO + 0xE2] = 0x01;
+    diskData[TRD_INFO + 0xE3] = diskType;
+    diskData[TRD_INFO + 0xE4] = 0x00;
+    diskData[TRD_INFO + 0xE5] = free & 0xFF;
+    diskData[TRD_INFO + 0xE6] = free >> 8;
+    diskData[TRD_INFO + 0xE7] = 0x10;   // TR-DOS ID
+    fill(&diskData[TRD_INFO + 0xEA], &diskData[TRD_INFO + 0xF3], 0x20);
+    fill(&diskData[TRD_INFO + 0xF5], &diskData[TRD_INFO + 0xFD], 0x20);
+
+    readDiskInfo();
+    diskOk = true;
+}
+
+uint8_t* TRDFile::sector(size_t cyl, size_t side, uint_fast8_t id) {
+
+    if (!diskOk || side >= numSides || cyl >= numTracks || !id || id > TRD_SECTORS) {
+        return nullptr;
+    }
+
+    size_t offset = (((cyl * numSides) + side) * TRD_SECTORS + id - 1) * TRD_SECTOR_SIZE;
+    return (offset + TRD_SECTOR_SIZE <= diskData.size()) ? &diskData[offset] : nullptr;
+}
+
+void TRDFile::readDiskInfo() {
 
+    freeSpaceAddress[0] = diskData[TRD_INFO + 0xE1];
+    freeSpaceAddress[1] = diskData[TRD_INFO + 0xE2];
+    numFiles = diskData[TRD_INFO + 0xE4];
+    numFreeSectors = diskData[TRD_INFO + 0xE5] | (diskData[TRD_INFO + 0xE6] << 8);
+    numDeleted = diskData[TRD_INFO + 0xF4];
+    copy(&diskData[TRD_INFO + 0xF5], &diskData[TRD_INFO + 0xFD], &diskLabel[0]);
 }
 
 // vim: et:sw=4:ts=4:
@@ -15,34 +15,48 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <vector>
 
+#include "FileView.h"
+
 /** TRDFile.h
  *
  * TRD and SCL file format implementation.
  *
  * This class loads a TRD or a SCL image.
+ *
+ * A TRD image is a dump of a TR-DOS disk, with 16 sectors of 256 bytes per
+ * track, and both sides of a cylinder one after the other. A SCL image only
+ * holds the files, which are copied to an empty TR-DOS disk when loading.
  */
 
+/** TR-DOS disks have 16 sectors per track, numbered from 1. */
+uint_fast8_t constexpr TRD_SECTORS = 16;
+size_t constexpr TRD_SECTOR_SIZE = 0x100;
+size_t constexpr TRD_TRACK_SIZE = TRD_SECTORS * TRD_SECTOR_SIZE;
+/** Disk info sector (track 0, sector 9). */
+size_t constexpr TRD_INFO = 0x800;
+
 class TRDFile {
 
     public:
-        TRDFile();
+        TRDFile() {}
 
-        uint_fast8_t numTracks;
-        uint_fast8_t numSides;
+        uint_fast8_t numTracks = 80;
+        uint_fast8_t numSides = 2;
 
         uint_fast8_t freeSpaceAddress[2];
-        uint_fast8_t diskType;
-        uint_fast8_t numFiles;
-        uint_fast8_t numDeleted;
-        uint_fast16_t numFreeSectors;
+        uint_fast8_t diskType = 0;
+        uint_fast8_t numFiles = 0;
+        uint_fast8_t numDeleted = 0;
+        uint_fast16_t numFreeSectors = 0;
         uint8_t diskLabel[8];
 
-        std::vector<uint8_t> diskData;
-        std::vector<uint8_t> fileData;
+        std::vector<uint8_t> diskData;  // Disk contents, which can be written.
+        FileView fileData;  // Only open while loading.
         bool diskOk = false;
 
         uint8_t sclMagic[8] = {'S', 'I', 'N', 'C', 'L', 'A', 'I', 'R'};
@@ -50,7 +64,25 @@ class TRDFile {
 
         void loadTRD(std::string const& fileName);
         void loadSCL(std::string const& fileName);
-        void save(std::string const& fileName);
+        bool save(std::string const& fileName);
+
+        /**
+         * Create an empty TR-DOS disk, 80 tracks and double sided.
+         */
+        void makeEmpty();
+
+        /**
+         * Find the data of a sector.
+         *
+         * @param cyl The cylinder.
+         * @param side The side.
+         * @param id The sector ID, from 1 to 16.
+         * @return The sector data, or nullptr if the sector does not exist.
+         */
+        uint8_t* sector(size_t cyl, size_t side, uint_fast8_t id);
+
+    private:
+        void readDiskInfo();
 };
 
 // vim: et:sw=4:ts=4:
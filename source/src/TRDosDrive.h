@@ -0,0 +1,142 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** TRDosDrive
+ *
+ * BetaDisk disk drive emulation.
+ *
+ * TR-DOS disks are formatted with 16 sectors of 256 bytes per track. The
+ * sectors are interleaved, so TR-DOS can read them in order without
+ * waiting for a whole revolution.
+ */
+
+#include "TRDFile.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Order of the sectors on a TR-DOS track. */
+uint8_t constexpr TRD_INTERLEAVE[TRD_SECTORS] = {
+    1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15, 8, 16
+};
+
+class TRDosDrive {
+
+    public:
+        TRDosDrive(bool ready = false) :
+            ready(ready) {}
+
+        bool disk = false;      // Disk is in drive
+        bool writeprot = false; // Disk is write protected
+        bool ready = false;     // Drive exists
+
+        size_t cylinder = 0;
+
+        std::vector<TRDFile> images;
+        std::vector<std::string> imageNames;
+        size_t currentImage = 0;
+
+        bool track0() const { return cylinder == 0; }
+
+        void stepIn() {
+
+            // Real drives have a few tracks more than TR-DOS uses.
+            if (cylinder < 86) {
+                ++cylinder;
+            }
+        }
+
+        void stepOut() {
+
+            if (cylinder > 0) {
+                --cylinder;
+            }
+        }
+
+        /**
+         * Find the data of a sector under the head.
+         *
+         * @return The sector data, or nullptr if there is no such sector.
+         */
+        uint8_t* sector(size_t side, uint_fast8_t id) {
+
+            return disk ? images[currentImage].sector(cylinder, side, id) : nullptr;
+        }
+
+        void nextDisk() {
+
+            if (images.size() > 0) {
+                ++currentImage;
+                if (currentImage == images.size()) {
+                    currentImage = 0;
+                }
+                std::cout << "Currently inserted disk: " << imageNames[currentImage] << std::endl;
+            }
+        }
+
+        void prevDisk() {
+
+            if (images.size() > 0) {
+                if (currentImage == 0) {
+                    currentImage = images.size();
+                }
+                --currentImage;
+                std::cout << "Currently inserted disk: " << imageNames[currentImage] << std::endl;
+            }
+        }
+
+        void emptyDisk() {
+
+            static size_t disks = 0;
+
+            std::stringstream ss;
+            ss << "Empty Disk " << disks;
+            ++disks;
+
+            TRDFile trd;
+            trd.makeEmpty();
+            images.push_back(std::move(trd));
+            imageNames.push_back(ss.str());
+            disk = true;
+
+            currentImage = images.size() - 1;
+            std::cout << "Currently inserted disk: " << imageNames[currentImage] << std::endl;
+        }
+
+        void saveDisk() {
+
+            static size_t disks = 0;
+
+            if (disk) {
+                std::stringstream ss;
+                ss << "savedisk" << std::dec << std::setw(2) << std::setfill('0') << disks << ".trd";
+                std::string name = ss.str();
+
+                std::cout << "Saving to " << name << std::endl;
+                images[currentImage].save(name);
+
+                disks = (disks + 1) % 100;
+            }
+        }
+};
+
+// vim: et:sw=4:ts=4
@@ -16,10 +16,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
 
+#include "CSWFile.h"
 #include "TZXFile.h"
 #include "Utils.h"
 
@@ -30,17 +30,12 @@ using namespace std;
 void TZXFile::load(string const& fileName) {
 
     name = fileName;
-    char c;
 
     magicIsOk = false;
+    finished = false;
+    pointer = 0;
 
-    ifstream ifs(fileName.c_str(), ifstream::binary);
-    if (ifs.good()) {
-        fileData.clear();
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
-
+    if (fileData.open(fileName) && fileData.size() >= 0x0A) {
         // TZX header is:
         // 0-6 - ZXTape!
         // 7   - 0x1A
@@ -57,11 +52,41 @@ void TZXFile::load(string const& fileName) {
 }
 
 void TZXFile::parse(
-        vector<uint32_t> &pulseData,
+        PulseData& pulseData,
         set<size_t> &indexData,
         set<size_t> &stopData,
         set<size_t> &stopIf48K) {
 
+    start(pulseData, indexData, stopData);
+    decode(pulseData, indexData, stopData, stopIf48K, SIZE_MAX);
+}
+
+void TZXFile::start(
+        PulseData& pulseData,
+        set<size_t> &indexData,
+        set<size_t> &stopData) {
+
+    finished = !magicIsOk;
+    if (magicIsOk) {
+        // Do not erase previous pulseData, so multiple tapes can be
+        // concatenated.
+        pointer = 0x0A;
+        romData.clear();
+        blocks.clear();
+        if (!pulseData.empty()) {
+            indexData.insert(pulseData.size());
+            stopData.insert(pulseData.size());
+        }
+    }
+}
+
+bool TZXFile::decode(
+        PulseData& pulseData,
+        set<size_t> &indexData,
+        set<size_t> &stopData,
+        set<size_t> &stopIf48K,
+        size_t pulses) {
+
     size_t dataLength;
     size_t headLength;
     uint8_t flagByte;
@@ -92,7 +117,8 @@ void TZXFile::parse(
     uint32_t cswCompression;
     uint32_t cswExpectedPulses;
     uint32_t cswPulses;
-    vector<uint8_t> cswBuffer;
+    uint32_t cswPulse;
+    CSWFile cswData;
 
     vector<uint32_t> pilotAlphabet;
     vector<uint32_t> dataAlphabet;
@@ -102,20 +128,12 @@ void TZXFile::parse(
     string blockName;
     ss.str("");
 
-    if (magicIsOk) {
-        // Do not erase previous pulseData, so multiple tapes can be
-        // concatenated.
-        pointer = 0x0A;
-        romData.clear();
-        if (!pulseData.empty()) {
-            indexData.insert(pulseData.size());
-            stopData.insert(pulseData.size());
-        }
-    } else {
-        return;
+    if (finished) {
+        return true;
     }
 
-    while (pointer < fileData.size()) {
+    // Parse whole blocks until there are enough pulses.
+    while (pointer < fileData.size() && pulseData.size() < pulses) {
         blockId = fileData[pointer];
 
         headLength = getBlockHeaderLength();
@@ -125,9 +143,17 @@ void TZXFile::parse(
             cout << "Pointer: " << pointer << endl;
             cout << "Header Length: " << headLength << endl;
             cout << "Remaining bytes: " << fileData.size() << endl;
+            pointer = fileData.size();
             break;
         }
 
+        TapeBlock block;
+        block.type = blockId;
+        block.start = pulseData.size();
+        size_t blockPointer = pointer;
+        size_t romStart = romData.size();
+        dataLength = 0;
+
         switch (blockId) {
             case 0x10:
                 blockName = "Standard Speed Data";
@@ -148,7 +174,7 @@ void TZXFile::parse(
                 }
 
                 // Pilot tone
-                pulseData.insert(pulseData.end(), pilotLength, pilotPulse);
+                pulseData.append(pilotLength, pilotPulse);
 
                 // Sync pulses
                 pulseData.push_back(syncPulse1);
@@ -163,8 +189,7 @@ void TZXFile::parse(
                     romData.push_back(byte);
 
                     for (size_t jj = 0; jj < 8; ++jj) {
-                        pulseData.insert(pulseData.end(),
-                                2, (byte & 0x80) ? dataPulse1 : dataPulse0);
+                        pulseData.append(2, (byte & 0x80) ? dataPulse1 : dataPulse0);
                         byte <<= 1;
                     }
                 }
@@ -195,7 +220,7 @@ void TZXFile::parse(
                 }
 
                 // Pilot tone
-                pulseData.insert(pulseData.end(), pilotLength, pilotPulse);
+                pulseData.append(pilotLength, pilotPulse);
 
                 // Sync pulses
                 pulseData.push_back(syncPulse1);
@@ -211,8 +236,7 @@ void TZXFile::parse(
 
                     bitsInByte = (ii == (dataLength - 1)) ? bitsInLastByte : 8;
                     for (size_t jj = 0; jj < bitsInByte; ++jj) {
-                        pulseData.insert(pulseData.end(),
-                                2, (byte & 0x80) ? dataPulse1 : dataPulse0);
+                        pulseData.append(2, (byte & 0x80) ? dataPulse1 : dataPulse0);
                         byte <<= 1;
                     }
                 }
@@ -229,7 +253,7 @@ void TZXFile::parse(
                 pilotLength = getU16(fileData, pointer + 3);
 
                 // Pilot tone
-                pulseData.insert(pulseData.end(), pilotLength, pilotPulse);
+                pulseData.append(pilotLength, pilotPulse);
                 pointer += headLength;
                 break;
 
@@ -271,8 +295,7 @@ void TZXFile::parse(
 
                     bitsInByte = (ii == (dataLength - 1)) ? bitsInLastByte : 8;
                     for (size_t jj = 0; jj < bitsInByte; ++jj) {
-                        pulseData.insert(pulseData.end(),
-                                2, (byte & 0x80) ? dataPulse1 : dataPulse0);
+                        pulseData.append(2, (byte & 0x80) ? dataPulse1 : dataPulse0);
                         byte <<= 1;
                     }
                 }
@@ -358,21 +381,11 @@ void TZXFile::parse(
                     break;
                 }
 
-                cswBuffer.assign(&fileData[pointer + 15], &fileData[(pointer + 15) + (dataLength - 10)]);
-                if (cswCompression == 2) {
-                    vector<uint8_t> temp(5 * cswExpectedPulses, 0x00);
-                    if (inflateBuffer(cswBuffer, temp)) {
-                        cswBuffer.assign(temp.begin(), temp.end());
-                    }
-                }
+                cswData.open(fileData.data() + pointer + 15, dataLength - 10, cswCompression == 2);
 
                 cswPulses = 0;
-                for (size_t ii = 0; ii < cswBuffer.size(); ++ii) {
-                    double pulse = cswBuffer[ii];
-                    if (cswBuffer[ii] == 0x00) {
-                        pulse = getU32(cswBuffer, ii + 1);
-                        ii += 4;
-                    }
+                while (cswData.readPulse(cswPulse)) {
+                    double pulse = cswPulse;
                     ++cswPulses;
                     pulse *= 3500000.0 / cswRate;
                     pulseData.push_back(static_cast<uint32_t>(pulse));
@@ -564,18 +577,44 @@ void TZXFile::parse(
                 break;
         }
 
+        // Add the blocks that produce pulses to the catalogue.
+        if (blockId >= TAPE_BLOCK_STANDARD && blockId <= TAPE_BLOCK_GENERALIZED
+                && pulseData.size() > block.start) {
+            block.end = pulseData.size();
+            if (romData.size() > romStart) {
+                block.data = romStart;
+            }
+            if (blockId == TAPE_BLOCK_STANDARD || blockId == TAPE_BLOCK_TURBO
+                    || blockId == TAPE_BLOCK_DATA) {
+                block.identify(fileData.data() + blockPointer + headLength, dataLength);
+            }
+            blocks.push_back(block);
+        }
+
         cout << "Found " << blockName << " block: " << endl;
         cout << ss.str();
         ss.str("");
         ss.clear();
     }
 
+    if (pointer < fileData.size()) {
+        return false;
+    }
+
     // Insert a couple of pulses to ensure there is an edge at the end of the tape.
     if (pulseData.size() % 2 == 0) {
         pulseData.push_back(3500);
     }
     pulseData.push_back(3500);
     cout << "Got " << pulseData.size() << " pulses." << endl;
+
+    finished = true;
+    return true;
+}
+
+double TZXFile::progress() const {
+
+    return fileData.size() ? static_cast<double>(pointer) / fileData.size() : 1.0;
 }
 
 size_t TZXFile::dumpArchiveInfo() {
@@ -703,7 +742,7 @@ size_t TZXFile::loadSymbolAlphabet(size_t base, uint32_t numSym, uint32_t maxLen
 }
 
 size_t TZXFile::dumpPilotStream(size_t base, uint32_t numSym,
-        vector<uint32_t> const& alphabet, vector<uint32_t>& data) {
+        vector<uint32_t> const& alphabet, PulseData& data) {
 
     uint32_t rep;
     uint32_t sym;
@@ -724,7 +763,7 @@ size_t TZXFile::dumpPilotStream(size_t base, uint32_t numSym,
 }
 
 size_t TZXFile::dumpDataStream(size_t base, uint32_t numSym, uint32_t bps,
-        vector<uint32_t> const& alphabet, vector<uint32_t>& data) {
+        vector<uint32_t> const& alphabet, PulseData& data) {
 
     uint32_t symbolStart = 0;
     uint32_t symbolEnd = bps;
@@ -759,7 +798,7 @@ size_t TZXFile::dumpDataStream(size_t base, uint32_t numSym, uint32_t bps,
 }
 
 void TZXFile::pushSymbol(uint32_t rep, uint32_t sym,
-        vector<uint32_t> const& alphabet, vector<uint32_t>& data) {
+        vector<uint32_t> const& alphabet, PulseData& data) {
 
     uint32_t size = alphabet[0];
     uint32_t type = alphabet[sym * size + 1];
@@ -786,15 +825,15 @@ void TZXFile::pushSymbol(uint32_t rep, uint32_t sym,
     }
 
     if (concatenate) {
-        data.back() += *first;
-        data.insert(data.end(), first + 1, last);
+        data.extendLast(*first);
+        data.append(first + 1, last);
     }
     for (uint32_t ii = concatenate; ii < rep; ++ii) {
-        data.insert(data.end(), first, last);
+        data.append(first, last);
     }
 }
 
-void TZXFile::addPause(uint32_t pause, vector<uint32_t>& data) {
+void TZXFile::addPause(uint32_t pause, PulseData& data) {
 
     if (pause) {
         data.push_back(945);
@@ -21,12 +21,18 @@
 #include <string>
 #include <vector>
 
+#include "FileView.h"
+#include "PulseData.h"
+#include "TapeBlock.h"
+
 /** TZXFile.h
  *
  * TZX file format implementation.
  *
  * This class loads a TZX file and generates pulses that will be fed to the
  * Spectrum EAR port.
+ *
+ * Blocks can be decoded a few at a time, as the tape plays.
  */
 
 class TZXFile {
@@ -41,10 +47,12 @@ class TZXFile {
         uint8_t majorVersion = 0;
         uint8_t minorVersion = 0;
 
-        std::vector<uint8_t> fileData;
+        FileView fileData;
         std::vector<uint8_t> romData;
+        std::vector<TapeBlock> blocks;  // Block catalogue. Data offsets are in romData.
 
         size_t pointer = 0;
+        bool finished = false;
         size_t loopStart = 0;
         size_t loopCounter = 0;
 
@@ -52,11 +60,37 @@ class TZXFile {
 
         void load(std::string const& fileName);
         void parse(
-                std::vector<uint32_t> &pulseData,
+                PulseData& pulseData,
                 std::set<size_t> &indexData,
                 std::set<size_t> &stopData,
                 std::set<size_t> &stopIf48K);
 
+        /**
+         * Prepare for decoding blocks, after loading.
+         */
+        void start(
+                PulseData& pulseData,
+                std::set<size_t> &indexData,
+                std::set<size_t> &stopData);
+
+        /**
+         * Decode whole blocks until there are enough pulses.
+         *
+         * @param pulses Number of pulses wanted in pulseData.
+         * @return True if the end of the file has been reached.
+         */
+        bool decode(
+                PulseData& pulseData,
+                std::set<size_t> &indexData,
+                std::set<size_t> &stopData,
+                std::set<size_t> &stopIf48K,
+                size_t pulses);
+
+        /**
+         * Fraction of the file decoded so far.
+         */
+        double progress() const;
+
         size_t dumpArchiveInfo();
         size_t dumpComment();
         size_t dumpMessage();
@@ -66,12 +100,12 @@ class TZXFile {
         size_t loadSymbolAlphabet(size_t base, uint32_t numSym, uint32_t maxLen,
                 std::vector<uint32_t>& alphabet);
         size_t dumpPilotStream(size_t base, uint32_t numSym,
-                std::vector<uint32_t> const& alphabet, std::vector<uint32_t>& data);
+                std::vector<uint32_t> const& alphabet, PulseData& data);
         size_t dumpDataStream(size_t base, uint32_t numSym, uint32_t bps,
-                std::vector<uint32_t> const& alphabet, std::vector<uint32_t>& data);
+                std::vector<uint32_t> const& alphabet, PulseData& data);
         void pushSymbol(uint32_t rep, uint32_t sym,
-                std::vector<uint32_t> const& alphabet, std::vector<uint32_t>& data);
-        void addPause(uint32_t pause, std::vector<uint32_t>& data);
+                std::vector<uint32_t> const& alphabet, PulseData& data);
+        void addPause(uint32_t pause, PulseData& data);
 
         size_t getBlockHeaderLength();
 };
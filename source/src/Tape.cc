@@ -17,36 +17,52 @@
 
 void Tape::loadTzx(string const& fileName) {
 
-    counter = pulseData.size();
+    // Finish the previous file, since new pulses go after it.
+    decode(SIZE_MAX);
+    counter = sourceStart = pulseData.size();
 
-    // Create a .tzx object, load its contents in pulseData.
-    TZXFile tzx;
+    // Open the .tzx file, its blocks are decoded as the tape plays.
+    set<size_t> indexData, stopData;
     tzx.load(fileName);
-    tzx.parse(pulseData, indexData, stopData, stopIf48K);
-    loadData.insert(loadData.end(), tzx.romData.begin(), tzx.romData.end());
+    tzx.start(pulseData, indexData, stopData);
+    addEvents(indexData, stopData);
+
+    source = TAPE_SOURCE_TZX;
+    decode(pulseData.size() + TAPE_DECODE_AHEAD);
 
     updateFlashTap();
 }
 
 void Tape::loadCdt(string const& fileName) {
 
-    counter = pulseData.size();
+    decode(SIZE_MAX);
+    counter = sourceStart = pulseData.size();
+
+    // Open the .tzx file. The pulses are scaled to match the CPU speed
+    // on playback.
+    set<size_t> indexData, stopData;
+    tzx.load(fileName);
+    tzx.start(pulseData, indexData, stopData);
+    addEvents(indexData, stopData);
+
+    source = TAPE_SOURCE_CDT;
+    decode(pulseData.size() + TAPE_DECODE_AHEAD);
 
-    // Create a .tzx object, load its contents in pulseData, scaled to
-    // match the CPU speed.
-    TZXFile cdt;
-    cdt.load(fileName);
-    cdt.parse(pulseData, indexData, stopData, stopIf48K);
+    updateFlashTap();
 }
 
 void Tape::loadPzx(string const& fileName) {
 
+    decode(SIZE_MAX);
     counter = pulseData.size();
 
     // Create a .pzx object, load its contents in pulseData.
     PZXFile pzx;
+    set<size_t> indexData, stopData, stopIf48K;
     pzx.load(fileName);
     pzx.parse(pulseData, indexData, stopData, stopIf48K);
+    addEvents(indexData, stopData, stopIf48K);
+    addBlocks(pzx.blocks, loadData.size());
     loadData.insert(loadData.end(), pzx.romData.begin(), pzx.romData.end());
 
     updateFlashTap();
@@ -54,25 +70,172 @@ void Tape::loadPzx(string const& fileName) {
 
 void Tape::loadTap(string const& fileName) {
 
+    decode(SIZE_MAX);
     counter = pulseData.size();
 
     // Create a .tap object, load its contents in pulseData.
     TAPFile tap;
+    set<size_t> indexData, stopData;
     tap.load(fileName);
+    size_t base = loadData.size();
     loadData.insert(loadData.end(), tap.fileData.begin(), tap.fileData.end());
     tap.parse(pulseData, indexData, stopData);
+    addEvents(indexData, stopData);
+    addBlocks(tap.blocks, base);
 
     updateFlashTap();
 }
 
 void Tape::loadCsw(string const& fileName) {
 
-    counter = pulseData.size();
+    decode(SIZE_MAX);
+    counter = sourceStart = pulseData.size();
 
-    // Create a .csw object, load its contents in pulseData.
-    CSWFile csw;
+    // Open the .csw file, its pulses are decoded as the tape plays.
+    set<size_t> indexData, stopData;
     csw.load(fileName);
-    csw.parse(pulseData, indexData, stopData);
+    if (csw.magicIsOk) {
+        csw.start(pulseData, indexData, stopData);
+        addEvents(indexData, stopData);
+
+        // The whole recording is a single block.
+        TapeBlock block;
+        block.type = TAPE_BLOCK_CSW;
+        block.start = sourceStart;
+        block.end = pulseData.size();
+        blocks.push_back(block);
+
+        source = TAPE_SOURCE_CSW;
+        decode(pulseData.size() + TAPE_DECODE_AHEAD);
+    }
+}
+
+void Tape::decode(size_t pulses) {
+
+    set<size_t> indexData, stopData, stopIf48K;
+    bool done = true;
+
+    switch (source) {
+        case TAPE_SOURCE_TZX:
+        case TAPE_SOURCE_CDT:
+            done = tzx.decode(pulseData, indexData, stopData, stopIf48K, pulses);
+            addBlocks(tzx.blocks, loadData.size());
+            if (!tzx.romData.empty()) {
+                loadData.insert(loadData.end(), tzx.romData.begin(), tzx.romData.end());
+                if (!useSaveData) {
+                    tapData.insert(tapData.end(), tzx.romData.begin(), tzx.romData.end());
+                }
+                tzx.romData.clear();
+            }
+            break;
+
+        case TAPE_SOURCE_CSW:
+            done = csw.decode(pulseData, pulses);
+            blocks.back().end = pulseData.size();
+            break;
+
+        default:
+            return;
+    }
+
+    if (done) {
+        source = TAPE_SOURCE_NONE;
+        tzx.fileData.close();
+        csw.fileData.close();
+    }
+
+    // This also places the pulse cursor again, since the last pulses may
+    // have been stored differently.
+    addEvents(indexData, stopData, stopIf48K);
+}
+
+void Tape::addBlocks(vector<TapeBlock>& added, size_t base) {
+
+    for (TapeBlock& block : added) {
+        if (block.data != SIZE_MAX) {
+            block.data += base;
+        }
+        blocks.push_back(block);
+    }
+    added.clear();
+}
+
+size_t Tape::block() const {
+
+    vector<TapeBlock>::const_iterator it = upper_bound(blocks.begin(), blocks.end(), pointer,
+            [](size_t p, TapeBlock const& b) { return p < b.start; });
+    return (it != blocks.begin() && pointer < (it - 1)->end) ? (it - blocks.begin() - 1) : blocks.size();
+}
+
+bool Tape::seekBlock(size_t n) {
+
+    while (n >= blocks.size() && source != TAPE_SOURCE_NONE) {
+        decode(pulseData.size() + TAPE_DECODE_AHEAD);
+    }
+
+    if (n >= blocks.size()) {
+        cout << "Block " << n << " not found." << endl;
+        return false;
+    }
+
+    rewind(blocks[n].start);
+    if (!useSaveData && blocks[n].data != SIZE_MAX) {
+        tapPointer = blocks[n].data;
+    }
+    return true;
+}
+
+bool Tape::listBlocks(string const& fileName) {
+
+    size_t dot = fileName.find_last_of('.');
+    string extension = (dot != string::npos) ? fileName.substr(dot) : "";
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    // The file parsers print what they decode. Only the catalogue is shown.
+    streambuf* out = cout.rdbuf(nullptr);
+    if (extension == ".tzx") {
+        loadTzx(fileName);
+    } else if (extension == ".cdt") {
+        loadCdt(fileName);
+    } else if (extension == ".tap") {
+        loadTap(fileName);
+    } else if (extension == ".pzx") {
+        loadPzx(fileName);
+    } else if (extension == ".csw") {
+        loadCsw(fileName);
+    } else {
+        cout.rdbuf(out);
+        return false;
+    }
+    decode(SIZE_MAX);
+    cout.rdbuf(out);
+
+    cout << "Blocks in " << fileName << ":" << endl;
+
+    for (size_t ii = 0; ii < blocks.size(); ++ii) {
+        TapeBlock const& block = blocks[ii];
+        cout << setw(4) << ii << "  Type: " << hex << setfill('0') << setw(2)
+            << static_cast<size_t>(block.type) << dec << setfill(' ')
+            << "  Pulses: " << setw(9) << block.start << " - " << setw(9) << block.end;
+        if (block.length) {
+            cout << "  Flag: " << setw(3) << static_cast<size_t>(block.flag)
+                << "  Length: " << setw(5) << block.length;
+        }
+        if (block.name[0]) {
+            cout << "  Name: " << block.name;
+        }
+        cout << endl;
+    }
+    cout << endl;
+    return true;
+}
+
+size_t Tape::memory() const {
+
+    return pulseData.memory()
+        + events.capacity() * sizeof(TapeEvent)
+        + blocks.capacity() * sizeof(TapeBlock)
+        + tapData.capacity() + saveData.capacity() + loadData.capacity();
 }
 
 void Tape::updateFlashTap() {
@@ -92,6 +255,7 @@ void Tape::rewind(size_t position) {
 
     playing = false;
     pointer = position;
+    seekEvent();
 
     // Load next pulse at once.
     sample = 0;
@@ -111,27 +275,44 @@ void Tape::resetCounter() {
     cout << "Set counter at " << pointer << "..." << endl;
 }
 
-void Tape::advance() {
+uint32_t Tape::percent() const {
 
-    if (pointer < pulseData.size()) {
-        // If we reach an index, we mark it.
-        if (indexData.find(pointer) != indexData.end()) {
-            cout << "Reached index: " << pointer << endl;
-            index = pointer;
-        }
+    // Estimate the length of a file still being decoded.
+    double length = static_cast<double>(pulseData.size());
+    double decoded = 1.0;
+    switch (source) {
+        case TAPE_SOURCE_TZX:
+        case TAPE_SOURCE_CDT:
+            decoded = tzx.progress();
+            break;
 
-        if (stopData.find(pointer) != stopData.end()) {
-            cout << "Stopped." << endl;
-            playing = false;
-        }
+        case TAPE_SOURCE_CSW:
+            decoded = csw.progress();
+            break;
+
+        default:
+            break;
+    }
+
+    if (decoded > 0.0) {
+        length = sourceStart + (length - sourceStart) / decoded;
+    }
+    return length ? static_cast<uint32_t>(min(100.0, 100.0 * pointer / length)) : 0;
+}
+
+void Tape::advance() {
+
+    if (source != TAPE_SOURCE_NONE && pointer + TAPE_DECODE_AHEAD / 2 >= pulseData.size()) {
+        decode(pointer + TAPE_DECODE_AHEAD);
+    }
 
-        if (is48K && stopIf48K.find(pointer) != stopIf48K.end()) {
-            cout << "Stopped in 48K mode." << endl;
-            playing = false;
+    if (pointer < pulseData.size()) {
+        if (pointer == eventPulse) {
+            reachEvent();
         }
 
         level ^= 0x7F;
-        sample = 2 * pulseData[pointer] * speed;
+        sample = 2 * pulseData.next(cursor) * speed;
         ++pointer;
     } else {
         // If we reach the end of the tape, stop, rewind and reset level.
@@ -140,14 +321,111 @@ void Tape::advance() {
     }
 }
 
+void Tape::frame() {
+
+    idleFrames = (reads >= TAPE_LOADING_READS) ? 0 : idleFrames + 1;
+    idleFrames = min(idleFrames, TAPE_IDLE_FRAMES);
+    reads = 0;
+}
+
+void Tape::reachEvent() {
+
+    uint8_t flags = events[nextEvent].flags;
+
+    // If we reach an index, we mark it.
+    if (flags & TAPE_EVENT_INDEX) {
+        cout << "Reached index: " << pointer << endl;
+        index = pointer;
+    }
+
+    if (flags & TAPE_EVENT_STOP) {
+        cout << "Stopped." << endl;
+        playing = false;
+    }
+
+    if (is48K && (flags & TAPE_EVENT_STOP48K)) {
+        cout << "Stopped in 48K mode." << endl;
+        playing = false;
+    }
+
+    ++nextEvent;
+    eventPulse = (nextEvent < events.size()) ? events[nextEvent].pulse : SIZE_MAX;
+}
+
+void Tape::seekEvent() {
+
+    pulseData.seek(cursor, pointer);
+    nextEvent = lower_bound(events.begin(), events.end(), pointer) - events.begin();
+    eventPulse = (nextEvent < events.size()) ? events[nextEvent].pulse : SIZE_MAX;
+}
+
+void Tape::addEvents(set<size_t> const& indexData,
+        set<size_t> const& stopData,
+        set<size_t> const& stopIf48K) {
+
+    // New events are always past the end of the previous tapes, so the
+    // array is kept sorted by merging the new ones and appending them.
+    vector<TapeEvent> added;
+    for (size_t pulse : indexData) {
+        added.push_back({pulse, TAPE_EVENT_INDEX});
+    }
+    for (size_t pulse : stopData) {
+        added.push_back({pulse, TAPE_EVENT_STOP});
+    }
+    for (size_t pulse : stopIf48K) {
+        added.push_back({pulse, TAPE_EVENT_STOP48K});
+    }
+
+    sort(added.begin(), added.end(),
+            [](TapeEvent const& a, TapeEvent const& b) { return a.pulse < b.pulse; });
+
+    for (TapeEvent const& event : added) {
+        if (!events.empty() && events.back().pulse == event.pulse) {
+            events.back().flags |= event.flags;
+        } else {
+            events.push_back(event);
+        }
+    }
+
+    seekEvent();
+}
+
+size_t Tape::findIndex(size_t pulse) {
+
+    // Decode more of the tape while no index is found.
+    while (true) {
+        for (size_t ii = lower_bound(events.begin(), events.end(), pulse) - events.begin();
+                ii < events.size(); ++ii) {
+            if (events[ii].flags & TAPE_EVENT_INDEX) {
+                return ii;
+            }
+        }
+
+        if (source == TAPE_SOURCE_NONE) {
+            return events.size();
+        }
+        decode(pulseData.size() + TAPE_DECODE_AHEAD);
+    }
+}
+
 void Tape::next() {
 
-    pointer = *(indexData.upper_bound(pointer + 1));
+    // Find the first index past the next pulse.
+    size_t ii = findIndex(pointer + 2);
+    if (ii < events.size()) {
+        pointer = events[ii].pulse;
+    }
+    seekEvent();
 }
 
 void Tape::prev() {
 
-    pointer = *(indexData.lower_bound(pointer - 1));
+    // Find the first index from the previous pulse on.
+    size_t ii = findIndex(pointer ? pointer - 1 : 0);
+    if (ii < events.size()) {
+        pointer = events[ii].pulse;
+    }
+    seekEvent();
 }
 
 uint_fast8_t Tape::getBlockByte(size_t offset) {
@@ -178,12 +456,34 @@ uint16_t Tape::getBlockLength() {
 
 void Tape::nextTapBlock() {
 
+    size_t loaded = tapPointer;
     tapPointer += 2 + getBlockLength();
 
+    while (tapPointer >= tapData.size() && !useSaveData
+            && (source == TAPE_SOURCE_TZX || source == TAPE_SOURCE_CDT)) {
+        decode(pulseData.size() + TAPE_DECODE_AHEAD);
+    }
+
     if (tapPointer >= tapData.size()) {
         tapPointer = 0;
     }
 
+    // Move the tape past the block just loaded. This is usually the block
+    // under the pulse pointer, or the next one.
+    if (!useSaveData) {
+        size_t first = upper_bound(blocks.begin(), blocks.end(), pointer,
+                [](size_t p, TapeBlock const& b) { return p < b.start; }) - blocks.begin();
+        first = first ? first - 1 : 0;
+        for (size_t ii = 0; ii < blocks.size(); ++ii) {
+            TapeBlock const& entry = blocks[(first + ii) % blocks.size()];
+            if (entry.data == loaded) {
+                pointer = entry.end;
+                seekEvent();
+                return;
+            }
+        }
+    }
+
     next();
 }
 
@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
@@ -27,8 +28,10 @@
 
 #include "CSWFile.h"
 #include "PZXFile.h"
+#include "PulseData.h"
 #include "TAPFile.h"
 #include "TZXFile.h"
+#include "TapeBlock.h"
 
 using namespace std;
 
@@ -37,15 +40,64 @@ using namespace std;
  * Tape streaming from different sources.
  *
  * This class generates a square wave from different data sources.
+ *
+ * Indexes and stop points are kept in a flat array sorted by pulse, and a
+ * cursor points to the next one ahead of the tape. Playback only compares
+ * the pulse pointer with the position of that event.
+ *
+ * TZX, CDT and CSW files are decoded as the tape plays, a few blocks ahead
+ * of the pulse pointer, so loading a large tape is immediate.
+ *
+ * Each file adds its blocks to a catalogue, sorted by pulse, with their
+ * position in the FlashTAP data. Seeking a block or finding the block that
+ * FlashTAP has just loaded does not need to go through the pulses.
  */
 
+/** Tape event flags. */
+uint8_t constexpr TAPE_EVENT_INDEX = 0x01;
+uint8_t constexpr TAPE_EVENT_STOP = 0x02;
+uint8_t constexpr TAPE_EVENT_STOP48K = 0x04;
+
+/** Tape files that are still being decoded. */
+uint8_t constexpr TAPE_SOURCE_NONE = 0;
+uint8_t constexpr TAPE_SOURCE_TZX = 1;
+uint8_t constexpr TAPE_SOURCE_CDT = 2;
+uint8_t constexpr TAPE_SOURCE_CSW = 3;
+
+/** Pulses decoded ahead of the pulse pointer. */
+size_t constexpr TAPE_DECODE_AHEAD = 0x10000;
+
+/**
+ * Tape input reads in a frame that mean a loader is running. Loaders read
+ * the port more than a thousand times per frame, keyboard routines only a few.
+ */
+uint32_t constexpr TAPE_LOADING_READS = 256;
+/** Frames without loading before the tape is considered idle. */
+uint32_t constexpr TAPE_IDLE_FRAMES = 25;
+
+struct TapeEvent {
+
+    size_t pulse;   // Position, relative to pulse data.
+    uint8_t flags;  // Index, stop, stop only in 48K mode.
+
+    bool operator<(size_t p) const { return pulse < p; }
+};
+
 class Tape {
 
     public:
-        vector<uint32_t> pulseData; // Pulse data, in samples per pulse.
-        set<size_t> indexData;      // Indexes relative to pulse data.
-        set<size_t> stopData;       // Stop points, relative to pulse data.
-        set<size_t> stopIf48K;      // Stop points only for 48K mode.
+        PulseData pulseData;        // Pulse data, in samples per pulse.
+        PulseCursor cursor;         // Playback position in pulse data.
+        vector<TapeEvent> events;   // Indexes and stop points, sorted.
+        size_t nextEvent = 0;       // First event not yet reached.
+        size_t eventPulse = SIZE_MAX;   // Position of the next event.
+
+        TZXFile tzx;                // TZX or CDT file being decoded.
+        CSWFile csw;                // CSW file being decoded.
+        uint8_t source = TAPE_SOURCE_NONE;
+        size_t sourceStart = 0;     // First pulse of the file being decoded.
+
+        vector<TapeBlock> blocks;   // Block catalogue, sorted by pulse.
 
         vector<uint8_t> tapData;    // Raw TAP data, just for tape load trap.
         size_t tapPointer = 0;      // Raw TAP pointer.
@@ -71,6 +123,8 @@ class Tape {
         double speed = 1.0;         // Tape speed factor (1.00 for ZX, 1.16 for CPC)
 
         bool playing = false;       // Is tape playing?
+        uint32_t reads = 0;         // Tape input reads in this frame.
+        uint32_t idleFrames = TAPE_IDLE_FRAMES; // Frames since the last load.
         bool is48K = true;          // For deciding if we stop or not :)
 
         Tape() {}
@@ -85,11 +139,66 @@ class Tape {
         void play();
         void rewind(size_t position = 0);
         void resetCounter();
+        uint32_t percent() const;
 
         void advance();
+        void frame();
+        bool loading() const { return playing && idleFrames < TAPE_IDLE_FRAMES; }
         void next();
         void prev();
 
+        void addEvents(set<size_t> const& indexData,
+                set<size_t> const& stopData,
+                set<size_t> const& stopIf48K = set<size_t>());
+        void seekEvent();
+        void reachEvent();
+        size_t findIndex(size_t pulse);
+
+        /**
+         * Add the blocks of a file to the catalogue.
+         *
+         * @param added Blocks from the file. The vector is emptied.
+         * @param base Position of the file data in loadData.
+         */
+        void addBlocks(vector<TapeBlock>& added, size_t base);
+
+        /**
+         * Get the block under the pulse pointer.
+         *
+         * @return Catalogue index, or blocks.size() if there is none.
+         */
+        size_t block() const;
+
+        /**
+         * Move the tape to the start of a block, decoding up to it if needed.
+         * FlashTAP also moves to the block, if it is using the load data.
+         *
+         * @param n Catalogue index.
+         * @return True if the block exists.
+         */
+        bool seekBlock(size_t n);
+
+        /**
+         * Load a tape file, decode it and print its catalogue.
+         *
+         * @param fileName The file. Files that are not tapes are skipped.
+         * @return True if the file is a tape.
+         */
+        bool listBlocks(string const& fileName);
+
+        /**
+         * Memory used by the tape, in bytes. This includes the pulses, the
+         * events, the catalogue and the FlashTAP data.
+         */
+        size_t memory() const;
+
+        /**
+         * Decode the current tape file until there are enough pulses.
+         *
+         * @param pulses Number of pulses wanted in pulseData.
+         */
+        void decode(size_t pulses);
+
         // Functions for tap blocks
         uint_fast8_t getBlockByte(size_t offset);
         bool foundTapBlock(uint_fast8_t flag);
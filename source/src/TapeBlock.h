@@ -0,0 +1,92 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** TapeBlock
+ *
+ * An entry in the tape block catalogue.
+ *
+ * Tape files add one entry for each block that produces pulses. Entries
+ * are plain values, so the catalogue is stored in a single array.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+/** Block types, same as the TZX block IDs. */
+uint8_t constexpr TAPE_BLOCK_STANDARD = 0x10;   // Also TAP blocks.
+uint8_t constexpr TAPE_BLOCK_TURBO = 0x11;      // Also PZX data blocks.
+uint8_t constexpr TAPE_BLOCK_TONE = 0x12;
+uint8_t constexpr TAPE_BLOCK_PULSES = 0x13;
+uint8_t constexpr TAPE_BLOCK_DATA = 0x14;
+uint8_t constexpr TAPE_BLOCK_DIRECT = 0x15;
+uint8_t constexpr TAPE_BLOCK_CSW = 0x18;        // Also CSW files.
+uint8_t constexpr TAPE_BLOCK_GENERALIZED = 0x19;
+
+/** Length of the file names in Spectrum and CPC headers. */
+size_t constexpr TAPE_SPECTRUM_NAME = 10;
+size_t constexpr TAPE_CPC_NAME = 16;
+
+struct TapeBlock {
+
+    size_t start = 0;           // First pulse.
+    size_t end = 0;             // First pulse after the block.
+    size_t data = SIZE_MAX;     // Offset in the FlashTAP data, if any.
+    size_t length = 0;          // Data bytes, including the flag.
+    uint8_t type = 0;           // Block type.
+    uint8_t flag = 0;           // First data byte. (Flag or sync byte.)
+    char name[TAPE_CPC_NAME + 1] = {};  // File name, if it is a header.
+
+    /**
+     * Take the flag and the file name from the block data.
+     *
+     * Spectrum headers have flag 0x00 and 19 bytes. CPC headers have sync
+     * byte 0x2C, and the name in the first bytes of the first segment.
+     *
+     * @param bytes Block data, starting with the flag.
+     * @param size Number of bytes.
+     */
+    void identify(uint8_t const* bytes, size_t size) {
+
+        length = size;
+        if (!size) {
+            return;
+        }
+
+        flag = bytes[0];
+        if (flag == 0x00 && size == 19) {
+            setName(bytes + 2, TAPE_SPECTRUM_NAME);
+        } else if (flag == 0x2C && size > TAPE_CPC_NAME) {
+            setName(bytes + 1, TAPE_CPC_NAME);
+        }
+    }
+
+    void setName(uint8_t const* bytes, size_t size) {
+
+        // Spectrum names are padded with spaces, CPC names with zeros.
+        // Keep names printable.
+        size_t ii = 0;
+        for (; ii < size && bytes[ii]; ++ii) {
+            name[ii] = (bytes[ii] >= 0x20 && bytes[ii] < 0x7F) ? bytes[ii] : '?';
+        }
+        while (ii && name[ii - 1] == ' ') {
+            --ii;
+        }
+        name[ii] = '\0';
+    }
+};
+
+// vim: et:sw=4:ts=4
@@ -0,0 +1,261 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TapeRecorder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <vector>
+
+#include "Utils.h"
+
+using namespace std;
+
+static void putU16(vector<uint8_t>& v, uint32_t value) {
+
+    v.push_back(value & 0xFF);
+    v.push_back((value >> 8) & 0xFF);
+}
+
+static void putU24(vector<uint8_t>& v, uint32_t value) {
+
+    putU16(v, value);
+    v.push_back((value >> 16) & 0xFF);
+}
+
+static void putU32(vector<uint8_t>& v, uint32_t value) {
+
+    putU16(v, value);
+    putU16(v, value >> 16);
+}
+
+static void writeBytes(ofstream& ofs, vector<uint8_t> const& v) {
+
+    ofs.write(reinterpret_cast<char const*>(v.data()), v.size());
+}
+
+void TapeRecorder::start(double clock, uint32_t time) {
+
+    pulseData.clear();
+    ticks = clock / TAPE_CLOCK;
+    level = false;
+    last = time;
+    elapsed = 0;
+    edgeTime = 0;
+    recording = true;
+}
+
+void TapeRecorder::edge(uint32_t time) {
+
+    frame(time);
+
+    // Pulses are measured from the start, so rounding errors do not add up.
+    uint64_t now = static_cast<uint64_t>(elapsed / ticks);
+    uint64_t pulse = now - edgeTime;
+    edgeTime = now;
+
+    // Do not keep the silence before the first edge.
+    if (pulseData.empty()) {
+        pulse = min<uint64_t>(pulse, TAPE_CLOCK);
+    }
+
+    pulseData.push_back(static_cast<uint32_t>(max<uint64_t>(1, min<uint64_t>(pulse, TAPE_MAX_PULSE))));
+    level = !level;
+}
+
+void TapeRecorder::frame(uint32_t time) {
+
+    elapsed += static_cast<uint32_t>(time - last);
+    last = time;
+}
+
+uint32_t TapeRecorder::tail() const {
+
+    // The last level lasts until now, up to one second.
+    uint64_t pulse = static_cast<uint64_t>(elapsed / ticks) - edgeTime;
+    return static_cast<uint32_t>(max<uint64_t>(1, min<uint64_t>(pulse, TAPE_CLOCK)));
+}
+
+bool TapeRecorder::save(string const& fileName) {
+
+    if (pulseData.empty()) {
+        cout << "No tape output recorded." << endl;
+        return false;
+    }
+
+    ofstream ofs(fileName, std::ofstream::binary);
+    if (!ofs.good()) {
+        cout << "Cannot write tape file: " << fileName << endl;
+        return false;
+    }
+
+    size_t dot = fileName.find_last_of('.');
+    string extension = (dot != string::npos) ? fileName.substr(dot) : "";
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == ".tzx") {
+        saveTzx(ofs);
+    } else if (extension == ".csw") {
+        saveCsw(ofs);
+    } else {
+        savePzx(ofs);
+    }
+    ofs.close();
+
+    cout << "Saved " << pulseData.size() + 1 << " pulses to " << fileName << endl;
+    return true;
+}
+
+void TapeRecorder::savePzx(ofstream& ofs) {
+
+    // PZXT header, version 1.0.
+    vector<uint8_t> block = {'P', 'Z', 'X', 'T', 2, 0, 0, 0, 1, 0};
+    writeBytes(ofs, block);
+
+    // A single PULS block. Repeated pulses are stored as a count and a
+    // duration. Durations of 32768 T-states or more take two words.
+    vector<uint8_t> body;
+    PulseCursor cursor;
+    pulseData.seek(cursor, 0);
+
+    size_t remaining = pulseData.size() + 1;
+    uint32_t pulse = pulseData.next(cursor);
+    while (remaining) {
+        uint32_t count = 1;
+        uint32_t next = 0;
+        while (--remaining) {
+            next = (remaining > 1) ? pulseData.next(cursor) : tail();
+            if (next != pulse || count == 0x7FFF) {
+                break;
+            }
+            ++count;
+        }
+
+        if (count > 1 || pulse >= 0x8000) {
+            putU16(body, 0x8000 | count);
+        }
+        if (pulse >= 0x8000) {
+            putU16(body, 0x8000 | (pulse >> 16));
+        }
+        putU16(body, pulse);
+        pulse = next;
+    }
+
+    block = {'P', 'U', 'L', 'S'};
+    putU32(block, static_cast<uint32_t>(body.size()));
+    writeBytes(ofs, block);
+    writeBytes(ofs, body);
+}
+
+void TapeRecorder::saveTzx(ofstream& ofs) {
+
+    // TZX header, version 1.20.
+    vector<uint8_t> block = {'Z', 'X', 'T', 'a', 'p', 'e', '!', 0x1A, 1, 20};
+    writeBytes(ofs, block);
+
+    // Sample the pulses, one bit per sample. The first pulse is low.
+    vector<uint8_t> data;
+    PulseCursor cursor;
+    pulseData.seek(cursor, 0);
+
+    uint64_t time = 0;
+    uint64_t samples = 0;
+    uint8_t byte = 0;
+    uint32_t bits = 0;
+    bool high = false;
+    for (size_t ii = 0; ii <= pulseData.size(); ++ii) {
+        time += (ii < pulseData.size()) ? pulseData.next(cursor) : tail();
+        uint64_t end = (time + TAPE_TZX_SAMPLE / 2) / TAPE_TZX_SAMPLE;
+        for (; samples < end; ++samples) {
+            byte = (byte << 1) | (high ? 1 : 0);
+            if (++bits == 8) {
+                data.push_back(byte);
+                byte = 0;
+                bits = 0;
+            }
+        }
+        high = !high;
+    }
+
+    uint32_t lastBits = 8;
+    if (bits) {
+        data.push_back(byte << (8 - bits));
+        lastBits = bits;
+    }
+
+    // Direct recording blocks hold up to 16MB each.
+    size_t const maxLength = 0xFFFFFF;
+    for (size_t pos = 0; pos < data.size(); pos += maxLength) {
+        size_t length = min(maxLength, data.size() - pos);
+        bool lastBlock = (pos + length == data.size());
+
+        block = {0x15};
+        putU16(block, TAPE_TZX_SAMPLE);
+        putU16(block, lastBlock ? 1000 : 0);
+        block.push_back(static_cast<uint8_t>(lastBlock ? lastBits : 8));
+        putU24(block, static_cast<uint32_t>(length));
+        writeBytes(ofs, block);
+        ofs.write(reinterpret_cast<char const*>(data.data() + pos), length);
+    }
+}
+
+void TapeRecorder::saveCsw(ofstream& ofs) {
+
+    // CSW v2 header. The sample rate is the T-state clock, so pulses are
+    // stored exactly, and the initial polarity is low.
+    vector<uint8_t> header = {
+        'C', 'o', 'm', 'p', 'r', 'e', 's', 's', 'e', 'd', ' ',
+        'S', 'q', 'u', 'a', 'r', 'e', ' ', 'W', 'a', 'v', 'e', 0x1A,
+        2, 0};
+    putU32(header, TAPE_CLOCK);
+    putU32(header, static_cast<uint32_t>(pulseData.size() + 1));
+    header.push_back(2);    // Z-RLE compression.
+    header.push_back(0);    // Flags.
+    header.push_back(0);    // Header extension length.
+    string application("SpecIde");
+    application.resize(16, '\0');
+    header.insert(header.end(), application.begin(), application.end());
+    writeBytes(ofs, header);
+
+    // RLE pulses are compressed in chunks.
+    DeflateStream deflater;
+    deflater.start(ofs);
+
+    vector<uint8_t> rle;
+    rle.reserve(0x1000);
+
+    PulseCursor cursor;
+    pulseData.seek(cursor, 0);
+    for (size_t ii = 0; ii <= pulseData.size(); ++ii) {
+        uint32_t pulse = (ii < pulseData.size()) ? pulseData.next(cursor) : tail();
+        if (pulse < 0x100) {
+            rle.push_back(static_cast<uint8_t>(pulse));
+        } else {
+            rle.push_back(0);
+            putU32(rle, pulse);
+        }
+
+        if (rle.size() > rle.capacity() - 5) {
+            deflater.write(rle.data(), rle.size());
+            rle.clear();
+        }
+    }
+
+    deflater.write(rle.data(), rle.size());
+    deflater.finish();
+}
+
+// vim: et:sw=4:ts=4
@@ -0,0 +1,103 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/** TapeRecorder
+ *
+ * Records the tape output (MIC) as a sequence of pulses.
+ *
+ * Edges are timestamped with the machine clock, and converted to T-states
+ * of a 3.5MHz clock, which is what tape files use. Pulses are kept in the
+ * same compressed storage used for playback, so a long recording takes
+ * little memory, and the storage grows in segments instead of per edge.
+ *
+ * The recording can be saved as PZX (PULS blocks), TZX (direct recording
+ * blocks) or CSW (ZLIB compressed RLE).
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "PulseData.h"
+
+/** Tape files use a 3.5MHz clock. */
+uint32_t constexpr TAPE_CLOCK = 3500000;
+/** T-states per sample in TZX direct recording blocks. (44.3kHz) */
+uint32_t constexpr TAPE_TZX_SAMPLE = 79;
+/** Longest pulse that PZX can store. */
+uint32_t constexpr TAPE_MAX_PULSE = 0x7FFFFFFF;
+
+class TapeRecorder {
+
+    public:
+        /** Record MIC edges. */
+        bool recording = false;
+
+        /** Recorded pulses, in T-states. The first pulse is low. */
+        PulseData pulseData;
+
+        /**
+         * Start a new recording.
+         *
+         * @param clock Frequency of the time stamps, in Hz.
+         * @param time Current time stamp.
+         */
+        void start(double clock, uint32_t time);
+
+        /**
+         * Set the MIC level.
+         *
+         * @param mic The new level.
+         * @param time Time stamp, in machine clock cycles. It may wrap.
+         */
+        void write(bool mic, uint32_t time) {
+            if (mic != level) {
+                edge(time);
+            }
+        }
+
+        /**
+         * Account for the time elapsed in a frame. This must be called
+         * at least once every few seconds, so time stamps do not wrap.
+         */
+        void frame(uint32_t time);
+
+        /**
+         * Save the recording. The format depends on the file extension:
+         * .tzx, .csw, or .pzx otherwise.
+         *
+         * @param fileName The file name.
+         * @return True if the file was written.
+         */
+        bool save(std::string const& fileName);
+
+    private:
+        double ticks = 2.0;         // Clock cycles per T-state.
+        bool level = false;         // Current MIC level.
+        uint32_t last = 0;          // Last time stamp.
+        uint64_t elapsed = 0;       // Clock cycles since the start.
+        uint64_t edgeTime = 0;      // Last edge, in T-states.
+
+        void edge(uint32_t time);
+        uint32_t tail() const;
+
+        void savePzx(std::ofstream& ofs);
+        void saveTzx(std::ofstream& ofs);
+        void saveCsw(std::ofstream& ofs);
+};
+
+// vim: et:sw=4:ts=4
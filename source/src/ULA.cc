@@ -330,6 +330,7 @@ void ULA::setEarLevel(bool level, bool playing) {
     vInc = vEnd - vEar;
     tapeLevel = level;
     tapePlaying = playing;
+    beeper();
 }
 
 uint_fast8_t ULA::ioRead() {
@@ -350,6 +351,7 @@ void ULA::ioWrite(uint_fast8_t byte) {
 
     soundBits = (byte & 0x18) >> 3;
     borderAttr = byte & 0x07;
+    beeper();
 
     if (ulaVersion < ULA_PLUS2) {
         if (!tapePlaying) {
@@ -365,7 +367,14 @@ void ULA::ioWrite(uint_fast8_t byte) {
 
 void ULA::beeper() {
 
-    // Smooth the signal directly from the ULA.
+    // The beeper is a sequence of level changes. The level that ends now is
+    // added to the filter weighted by the number of cycles it lasted, which
+    // is exactly what clocking the filter every cycle would have added.
+    if (playSound) {
+        filter.add(beeperLevel, cycles - beeperCycle);
+    }
+    beeperCycle = cycles;
+
     uint_fast16_t level = 0;
     if (playSound) {
         level += (soundBits & 0x02) ? ULA_BEEP_VOLUME : 0;
@@ -377,11 +386,12 @@ void ULA::beeper() {
         }
     }
 
-    filter.add(level);
+    beeperLevel = level;
 }
 
 int ULA::sample() {
 
+    beeper();
     return filter.get();
 }
 
@@ -395,6 +405,7 @@ void ULA::clock() {
     }
 
     tapeEarMic();
+    ++cycles;
 
     // Contention affects to Z80 phase change and to when the I/O operation
     // actually happens.
@@ -136,25 +136,28 @@ class ULA {
         uint_fast16_t z80_c_1 = 0xFFFF;
         uint_fast16_t z80_c_2 = 0xFFFF;
 
-        uint_fast16_t dataAddr;
-        uint_fast16_t attrAddr;
+        uint_fast16_t dataAddr = 0x0000;
+        uint_fast16_t attrAddr = 0x1800;
 
-        uint_fast8_t data;
-        uint_fast8_t attr;
-        uint_fast8_t dataReg;
-        uint_fast8_t attrReg;
-        uint_fast8_t latch;
+        uint_fast8_t data = 0x00;
+        uint_fast8_t attr = 0x00;
+        uint_fast8_t dataReg = 0x00;
+        uint_fast8_t attrReg = 0x00;
+        uint_fast8_t latch = 0x00;
 
         // Audio and tape signals
         Filter filter;
+        uint_fast32_t cycles = 0;
+        uint_fast32_t beeperCycle = 0;
+        uint_fast16_t beeperLevel = 0;
 
         bool playSound = true;
         bool tapeSound = true;
         uint_fast8_t micMask = 0x03;
 
         // Memory signals
-        uint_fast16_t a;
-        uint_fast8_t d;
+        uint_fast16_t a = 0x0000;
+        uint_fast8_t d = 0xFF;
 
         uint_fast16_t z80_a = 0xFFFF;
         uint_fast16_t z80_c = 0xFFFF;
@@ -35,23 +35,113 @@ void printBytes(string const& prefix, size_t len, uint8_t* buf) {
     cout << endl;
 }
 
-bool inflateBuffer(vector<uint8_t>& in, vector<uint8_t>& out) {
+InflateStream::InflateStream() :
+    stream(new z_stream()) {}
 
-    z_stream infstream;
-    infstream.zalloc = Z_NULL;
-    infstream.zfree = Z_NULL;
-    infstream.opaque = Z_NULL;
-    infstream.avail_in = in.size();
-    infstream.next_in = &in[0];
-    infstream.avail_out = out.size();
-    infstream.next_out = &out[0];
+InflateStream::~InflateStream() {
 
-    inflateInit(&infstream);
-    int ret = inflate(&infstream, Z_NO_FLUSH);
-    inflateEnd(&infstream);
-    out.resize(infstream.total_out);
+    if (active) {
+        inflateEnd(stream.get());
+    }
+}
+
+void InflateStream::start(uint8_t const* data, size_t size) {
+
+    if (active) {
+        inflateEnd(stream.get());
+    }
+
+    stream->zalloc = Z_NULL;
+    stream->zfree = Z_NULL;
+    stream->opaque = Z_NULL;
+    stream->avail_in = static_cast<uInt>(size);
+    stream->next_in = const_cast<Bytef*>(data);
+    active = (inflateInit(stream.get()) == Z_OK);
+}
+
+size_t InflateStream::read(uint8_t* out, size_t size) {
+
+    if (!active) {
+        return 0;
+    }
+
+    stream->avail_out = static_cast<uInt>(size);
+    stream->next_out = out;
+    int ret = inflate(stream.get(), Z_NO_FLUSH);
+    size_t produced = size - stream->avail_out;
+
+    // Stop at the end of the data, or at the first error.
+    if (ret != Z_OK || !produced) {
+        inflateEnd(stream.get());
+        active = false;
+    }
+    return produced;
+}
+
+size_t InflateStream::consumed() const {
+
+    return stream->total_in;
+}
+
+DeflateStream::DeflateStream() :
+    stream(new z_stream()) {}
 
-    return (ret >= 0);
+DeflateStream::~DeflateStream() {
+
+    if (active) {
+        deflateEnd(stream.get());
+    }
+}
+
+bool DeflateStream::start(ostream& os) {
+
+    if (active) {
+        deflateEnd(stream.get());
+    }
+
+    out = &os;
+    chunk.resize(0x10000);
+    stream->zalloc = Z_NULL;
+    stream->zfree = Z_NULL;
+    stream->opaque = Z_NULL;
+    active = (deflateInit(stream.get(), Z_BEST_COMPRESSION) == Z_OK);
+    return active;
+}
+
+void DeflateStream::write(uint8_t const* data, size_t size) {
+
+    if (!active) {
+        return;
+    }
+
+    stream->avail_in = static_cast<uInt>(size);
+    stream->next_in = const_cast<Bytef*>(data);
+    deflateChunks(Z_NO_FLUSH);
+}
+
+void DeflateStream::finish() {
+
+    if (!active) {
+        return;
+    }
+
+    stream->avail_in = 0;
+    deflateChunks(Z_FINISH);
+    deflateEnd(stream.get());
+    active = false;
+}
+
+void DeflateStream::deflateChunks(int flush) {
+
+    // Write the output every time the chunk is full, until zlib has
+    // consumed all the input (and written everything, if finishing).
+    int ret;
+    do {
+        stream->avail_out = static_cast<uInt>(chunk.size());
+        stream->next_out = chunk.data();
+        ret = deflate(stream.get(), flush);
+        out->write(reinterpret_cast<char*>(chunk.data()), chunk.size() - stream->avail_out);
+    } while (ret == Z_OK && (stream->avail_in || stream->avail_out == 0 || flush == Z_FINISH));
 }
 
 uint32_t getU32(vector<uint8_t> const& v, uint_fast32_t i) {
@@ -66,4 +156,16 @@ uint16_t getU16(vector<uint8_t> const& v, uint_fast32_t i) {
     return (v[i + 1] << 8) | v[i];
 }
 
+uint32_t getU32(FileView const& v, uint_fast32_t i) {
+    return (v[i + 3] << 24) | (v[i + 2] << 16) | (v[i + 1] << 8) | v[i];
+}
+
+uint32_t getU24(FileView const& v, uint_fast32_t i) {
+    return (v[i + 2] << 16) | (v[i + 1] << 8) | v[i];
+}
+
+uint16_t getU16(FileView const& v, uint_fast32_t i) {
+    return (v[i + 1] << 8) | v[i];
+}
+
 // vim: et:sw=4:ts=4
@@ -15,13 +15,88 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <ostream>
 #include <string>
 #include <vector>
 
+#include "FileView.h"
+
+struct z_stream_s;
+
 void printBytes(std::string const& prefix, size_t len, uint8_t* buf);
 
-bool inflateBuffer(std::vector<uint8_t>& in, std::vector<uint8_t>& out);
+/** InflateStream
+ *
+ * Inflates zlib data in chunks, so the whole output never needs to be
+ * in memory at once.
+ */
+class InflateStream {
+
+    public:
+        InflateStream();
+        ~InflateStream();
+
+        /**
+         * Start inflating a new buffer. The buffer must outlive the stream.
+         */
+        void start(uint8_t const* data, size_t size);
+
+        /**
+         * Inflate the next chunk.
+         *
+         * @return The number of bytes written, 0 at the end of the data.
+         */
+        size_t read(uint8_t* out, size_t size);
+
+        /**
+         * Bytes of compressed data consumed so far.
+         */
+        size_t consumed() const;
+
+    private:
+        std::unique_ptr<z_stream_s> stream;
+        bool active = false;
+};
+
+/** DeflateStream
+ *
+ * Compresses data with zlib as it is written, in chunks, so the whole
+ * output never needs to be in memory at once.
+ */
+class DeflateStream {
+
+    public:
+        DeflateStream();
+        ~DeflateStream();
+
+        /**
+         * Start compressing to a stream. The stream must outlive this one.
+         *
+         * @return True if zlib could be initialized.
+         */
+        bool start(std::ostream& os);
+
+        /**
+         * Compress some bytes.
+         */
+        void write(uint8_t const* data, size_t size);
+
+        /**
+         * Flush the compressed data and finish the stream.
+         */
+        void finish();
+
+    private:
+        std::unique_ptr<z_stream_s> stream;
+        std::ostream* out = nullptr;
+        std::vector<uint8_t> chunk;     // Compressed data.
+        bool active = false;
+
+        void deflateChunks(int flush);
+};
 
 uint32_t getU32(std::vector<uint8_t> const& v, uint_fast32_t i);
 
@@ -29,4 +104,10 @@ uint32_t getU24(std::vector<uint8_t> const& v, uint_fast32_t i);
 
 uint16_t getU16(std::vector<uint8_t> const& v, uint_fast32_t i);
 
+uint32_t getU32(FileView const& v, uint_fast32_t i);
+
+uint32_t getU24(FileView const& v, uint_fast32_t i);
+
+uint16_t getU16(FileView const& v, uint_fast32_t i);
+
 // vim: et:sw=4:ts=4
@@ -27,14 +27,9 @@ using namespace std;
 void Z80File::load(string const& fileName) {
 
     name = fileName;
-    char c;
 
-    ifstream ifs(fileName.c_str(), ifstream::binary);
-    if (ifs.good()) {
-        fileData.clear();
-        while (ifs.get(c)) {
-            fileData.push_back(c);
-        }
+    if (!fileData.open(fileName)) {
+        cout << "Cannot open file: " << fileName << endl;
     }
 }
 
@@ -241,7 +236,7 @@ bool Z80File::fillMemory() {
             if (length == 0xFFFF) {
                 if (dataIndex + 0x4000 <= fileData.size()) {
                     if (page != UINT8_MAX) {
-                        state.memory[page].assign(&fileData[dataIndex], &fileData[dataIndex + 0x4000]);
+                        state.memory[page].assign(fileData.data() + dataIndex, fileData.data() + dataIndex + 0x4000);
                     }
                     dataIndex += 0x4000;
                 } else {
@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <vector>
 
+#include "FileView.h"
 #include "SaveState.h"
 
 /** Z80File.h
@@ -36,7 +37,7 @@ class Z80File {
         std::string name;
         uint32_t dataIndex = 0;
 
-        std::vector<uint8_t> fileData;
+        FileView fileData;
         SaveState state;
 
         void load(std::string const& fileName);
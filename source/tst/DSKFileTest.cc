@@ -3,8 +3,11 @@
 #include <boost/test/unit_test.hpp>
 //#include <boost/test/included/unit_test.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "DSKFile.h"
@@ -37,6 +40,238 @@ BOOST_AUTO_TEST_CASE(constructors_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(arena_test)
+{
+    DSKFile file;
+    file.load(boost::unit_test::framework::master_test_suite().argv[1]);
+
+    // Sector data is stored in order, inside the arena.
+    size_t end = 0;
+    for (DSKFile::Track const& track : file.tracks) {
+        if (!track.trackSize || !track.magicOk) {
+            continue;
+        }
+        for (DSKFile::Track::Sector const& sector : track.sectors) {
+            BOOST_CHECK_GE(sector.dataOffset, end);
+            end = sector.dataOffset + sector.dataSize;
+            BOOST_CHECK_LE(end, file.arena.size());
+        }
+    }
+
+    // Writing a sector of the same size does not move it.
+    if (!file.tracks.empty() && !file.tracks[0].sectors.empty()) {
+        DSKFile::Track::Sector& sector = file.tracks[0].sectors[0];
+        size_t offset = sector.dataOffset;
+        size_t arena = file.arena.size();
+        vector<uint8_t> data(sector.dataSize, 0xA5);
+        file.store(sector, data.data(), data.size());
+        BOOST_CHECK_EQUAL(sector.dataOffset, offset);
+        BOOST_CHECK_EQUAL(file.arena.size(), arena);
+
+        DSKSpan span = file.sectorData(sector);
+        BOOST_CHECK(equal(span.begin(), span.end(), data.begin(), data.end()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(share_test)
+{
+    DSKFile file;
+    file.load(boost::unit_test::framework::master_test_suite().argv[1]);
+    vector<uint8_t> original;
+    file.save("share_test.dsk");
+    file.share();
+    BOOST_CHECK(file.arena.empty());
+
+    // Copies share the sector data.
+    DSKFile first(file);
+    DSKFile second(file);
+    BOOST_CHECK(first.base == second.base);
+    BOOST_CHECK(first.arena.empty());
+
+    // A written sector is copied, and the other images do not change.
+    if (!first.tracks.empty() && !first.tracks[0].sectors.empty()) {
+        DSKFile::Track::Sector& sector = first.tracks[0].sectors[0];
+        DSKSpan span = second.sectorData(second.tracks[0].sectors[0]);
+        original.assign(span.begin(), span.end());
+
+        vector<uint8_t> data(sector.dataSize, 0xC3);
+        first.store(sector, data.data(), data.size());
+        BOOST_CHECK(!sector.shared);
+        BOOST_CHECK_EQUAL(first.arena.size(), data.size());
+
+        span = first.sectorData(sector);
+        BOOST_CHECK(equal(span.begin(), span.end(), data.begin(), data.end()));
+        span = second.sectorData(second.tracks[0].sectors[0]);
+        BOOST_CHECK(equal(span.begin(), span.end(), original.begin(), original.end()));
+    }
+
+    // Unwritten images are saved as they were loaded.
+    BOOST_CHECK(second.save("share_test_copy.dsk"));
+    DSKFile saved;
+    DSKFile copied;
+    saved.load("share_test.dsk");
+    copied.load("share_test_copy.dsk");
+    BOOST_CHECK(saved.arena == copied.arena);
+
+    remove("share_test.dsk");
+    remove("share_test_copy.dsk");
+}
+
+BOOST_AUTO_TEST_CASE(flush_test)
+{
+    // Work on a copy, so the original image is not modified.
+    DSKFile original;
+    original.load(boost::unit_test::framework::master_test_suite().argv[1]);
+    BOOST_REQUIRE(original.save("flush_test.dsk"));
+
+    DSKFile file;
+    file.load("flush_test.dsk");
+    BOOST_CHECK(file.flush(false));
+
+    // A written sector is patched in place.
+    if (!file.tracks.empty() && !file.tracks[0].sectors.empty()) {
+        DSKFile::Track::Sector& sector = file.tracks[0].sectors[0];
+        vector<uint8_t> data(sector.dataSize, 0x5A);
+        file.store(sector, data.data(), data.size());
+        BOOST_CHECK(file.dirty);
+        BOOST_CHECK(file.flush(false));
+        BOOST_CHECK(!file.dirty);
+
+        DSKFile patched;
+        patched.load("flush_test.dsk");
+        BOOST_REQUIRE(!patched.tracks.empty() && !patched.tracks[0].sectors.empty());
+        DSKSpan span = patched.sectorData(patched.tracks[0].sectors[0]);
+        BOOST_CHECK(equal(span.begin(), span.end(), data.begin(), data.end()));
+        BOOST_CHECK_EQUAL(patched.arena.size(), file.arena.size());
+    }
+
+    remove("flush_test.dsk");
+}
+
+// Writes an extended DSK image with one track. Each sector has an 8-byte
+// entry in the table, with its stored length in the last two bytes, and
+// the data follows the track header.
+bool writeImage(string const& name, vector<uint8_t> const& sectors,
+        vector<uint8_t> const& data) {
+
+    size_t trackSize = 0x100;
+    for (size_t ii = 0; ii + 8 <= sectors.size(); ii += 8) {
+        trackSize += sectors[ii + 6] | (sectors[ii + 7] << 8);
+    }
+
+    vector<uint8_t> image(0x100, 0x00);
+    string const magic = "EXTENDED CPC DSK File\r\nDisk-Info\r\n";
+    copy(magic.begin(), magic.end(), image.begin());
+    image[0x30] = 1;
+    image[0x31] = 1;
+    image[0x34] = static_cast<uint8_t>(trackSize >> 8);
+
+    string const track = "Track-Info\r\n";
+    image.resize(0x200, 0x00);
+    copy(track.begin(), track.end(), image.begin() + 0x100);
+    image[0x114] = 2;
+    image[0x115] = static_cast<uint8_t>(sectors.size() / 8);
+    image[0x116] = 0x52;
+    image[0x117] = 0xE5;
+    copy(sectors.begin(), sectors.end(), image.begin() + 0x118);
+    image.insert(image.end(), data.begin(), data.end());
+
+    FILE* file = fopen(name.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(image.data(), 1, image.size(), file) == image.size();
+    fclose(file);
+    return ok;
+}
+
+BOOST_AUTO_TEST_CASE(weak_test)
+{
+    // One track, with a weak sector stored as three copies of 512 bytes.
+    vector<uint8_t> copies;
+    for (size_t cc = 0; cc < 3; ++cc) {
+        for (size_t ii = 0; ii < 0x200; ++ii) {
+            copies.push_back((ii >= 0x100 && ii < 0x104) ? (ii + cc) & 0xFF : ii & 0xFF);
+        }
+    }
+    BOOST_REQUIRE(writeImage("weak_test.dsk",
+                {0x00, 0x00, 0x02, 0x02, 0x20, 0x20, 0x00, 0x06}, copies));
+
+    // Only the bytes that differ are stored for the other copies.
+    DSKFile weak;
+    weak.load("weak_test.dsk");
+    BOOST_REQUIRE(!weak.tracks.empty() && !weak.tracks[0].sectors.empty());
+    DSKFile::Track::Sector const& s = weak.tracks[0].sectors[0];
+    BOOST_CHECK_EQUAL(s.copies, 3);
+    BOOST_CHECK_EQUAL(s.weak.size(), 1);
+    BOOST_CHECK_EQUAL(s.dataSize, 0x200 + 2 * 4);
+    BOOST_CHECK_EQUAL(weak.arena.size(), s.dataSize);
+
+    DSKSpan span = weak.sectorData(s);
+    BOOST_CHECK(equal(span.begin(), span.end(), copies.begin(), copies.begin() + 0x200));
+
+    vector<uint8_t> data;
+    for (size_t cc = 0; cc < 3; ++cc) {
+        weak.readData(s, cc * 0x200, 0x200, data);
+        BOOST_CHECK(equal(data.begin(), data.end(),
+                    copies.begin() + cc * 0x200, copies.begin() + (cc + 1) * 0x200));
+    }
+    weak.readData(s, 0x1FE, 0x300, data);
+    BOOST_CHECK(equal(data.begin(), data.end(), copies.begin() + 0x1FE, copies.begin() + 0x4FE));
+
+    // The copies are saved back as they were.
+    BOOST_CHECK(weak.save("weak_test_copy.dsk"));
+    DSKFile saved;
+    saved.load("weak_test_copy.dsk");
+    BOOST_REQUIRE(!saved.tracks.empty() && !saved.tracks[0].sectors.empty());
+    saved.readData(saved.tracks[0].sectors[0], 0, SIZE_MAX, data);
+    BOOST_CHECK(data == copies);
+
+    // A written weak sector has a single copy.
+    DSKFile::Track::Sector& w = weak.tracks[0].sectors[0];
+    vector<uint8_t> written(0x200, 0xA5);
+    weak.store(w, written.data(), written.size());
+    BOOST_CHECK_EQUAL(w.copies, 1);
+    BOOST_CHECK_EQUAL(w.storedSize(), 0x200);
+
+    remove("weak_test.dsk");
+    remove("weak_test_copy.dsk");
+}
+
+BOOST_AUTO_TEST_CASE(missing_data_test)
+{
+    // One track with two sectors of 512 bytes. The file ends before the
+    // data of the second one.
+    BOOST_REQUIRE(writeImage("missing_data_test.dsk", {
+                0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x02,
+                0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x02},
+                vector<uint8_t>(0x200, 0xA5)));
+
+    // The sector takes no space, and reads as 0xFF.
+    DSKFile missing;
+    missing.load("missing_data_test.dsk");
+    BOOST_REQUIRE(!missing.tracks.empty() && missing.tracks[0].sectors.size() == 2);
+    DSKFile::Track::Sector const& s = missing.tracks[0].sectors[1];
+    BOOST_CHECK_EQUAL(s.dataSize, 0);
+    BOOST_CHECK_EQUAL(missing.arena.size(), 0x200);
+
+    vector<uint8_t> data;
+    missing.readData(s, 0, SIZE_MAX, data);
+    BOOST_CHECK(data == vector<uint8_t>(0x200, 0xFF));
+    missing.readData(s, 0x100, 0x10, data);
+    BOOST_CHECK(data == vector<uint8_t>(0x10, 0xFF));
+
+    // It is saved without data.
+    BOOST_CHECK(missing.save("missing_data_test_copy.dsk"));
+    DSKFile saved;
+    saved.load("missing_data_test_copy.dsk");
+    BOOST_REQUIRE(!saved.tracks.empty() && saved.tracks[0].sectors.size() == 2);
+    BOOST_CHECK_EQUAL(saved.tracks[0].sectors[1].dataSize, 0);
+
+    remove("missing_data_test.dsk");
+    remove("missing_data_test_copy.dsk");
+}
+
 // EOF
 // vim: et:sw=4:ts=4
 
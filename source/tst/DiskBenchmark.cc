@@ -0,0 +1,407 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** DiskBenchmark
+ *
+ * Measures the disk subsystem on a set of DSK files, without a window.
+ *
+ * Usage: DiskBenchmark [-r repeats] diskfiles...
+ *
+ * For each file, it runs a script of FDC765 commands as the +3 and the
+ * CPC 6128 do: it reads the catalogue, then every sector of the disk, and
+ * then writes the sectors of a few tracks. The FDC is clocked as in each
+ * machine, and the CPU side polls the main status register like the ROM
+ * routines do. Each script runs with accurate timing and in fast mode.
+ *
+ * It reports the emulated seconds per host second, and the host time and
+ * emulated time per command.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DSKFile.h"
+#include "FDC765.h"
+
+using namespace std;
+
+/** A machine, as seen from the disk controller. */
+struct Machine {
+
+    string name;
+    float clockFrequency;   // FDC clock, in MHz.
+    size_t poll;            // FDC clocks between status reads.
+};
+
+/** The +3 clocks the FDC at 1MHz, the CPC at 4MHz. */
+Machine const machines[] = {
+    {"+3", 1.0, 6},
+    {"CPC 6128", 4.0, 24}
+};
+
+enum Command {
+    SPECIFY,
+    RECALIBRATE,
+    SEEK,
+    SENSE_INT,
+    READ_ID,
+    READ_DATA,
+    WRITE_DATA,
+    NUM_COMMANDS
+};
+
+char const* const commandNames[NUM_COMMANDS] = {
+    "Specify", "Recalibrate", "Seek", "Sense Int", "Read ID", "Read Data", "Write Data"
+};
+
+struct Result {
+
+    size_t count[NUM_COMMANDS] = {};
+    uint64_t clocks[NUM_COMMANDS] = {};     // FDC clocks per command.
+    double time[NUM_COMMANDS] = {};         // Host seconds per command.
+    size_t bytes = 0;                       // Data bytes transferred.
+    size_t errors = 0;                      // Commands that ended with errors.
+    uint64_t total = 0;                     // FDC clocks.
+    double host = 0.0;                      // Host seconds.
+};
+
+double seconds(chrono::steady_clock::time_point start) {
+
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+double rate(double count, double time) {
+
+    return (time > 0.0) ? count / time : 0.0;
+}
+
+class Session {
+
+    public:
+        Session(Machine const& machine, DSKFile const& image, bool fast) :
+            machine(machine) {
+
+            fdc.clockFrequency = machine.clockFrequency;
+            fdc.fastMode = fast;
+            fdc.reset();
+            fdc.drive[0].addImage(image, "benchmark");
+            fdc.motor(true);
+        }
+
+        FDC765 fdc;
+        Machine const& machine;
+        Result result;
+
+        /**
+         * Run a command, and collect the data and the result bytes.
+         *
+         * @return The result bytes.
+         */
+        vector<uint8_t> command(Command cmd, vector<uint8_t> const& bytes,
+                vector<uint8_t> const& data = vector<uint8_t>()) {
+
+            uint64_t start = clocks;
+            chrono::steady_clock::time_point host = chrono::steady_clock::now();
+
+            for (uint8_t byte : bytes) {
+                wait(SREG_DIO, 0x00);
+                fdc.write(byte);
+                tick();
+            }
+
+            // Non-DMA mode: the execution phase transfers the data bytes
+            // through the data register, like the result phase does.
+            vector<uint8_t> res;
+            size_t index = 0;
+            tick();
+            for (uint_fast8_t status = fdc.status(); status & SREG_CB; status = fdc.status()) {
+                if (status & SREG_RQM) {
+                    if (status & SREG_DIO) {
+                        res.push_back(fdc.read());
+                    } else if (status & SREG_EXM) {
+                        fdc.write((index < data.size()) ? data[index] : 0x00);
+                        ++index;
+                        ++result.bytes;
+                    }
+                }
+                tick();
+            }
+
+            // Data bytes are read in the execution phase.
+            if (cmd == READ_DATA && res.size() > 7) {
+                result.bytes += res.size() - 7;
+                res.erase(res.begin(), res.end() - 7);
+            }
+
+            result.time[cmd] += seconds(host);
+            result.clocks[cmd] += clocks - start;
+            ++result.count[cmd];
+            if (failed(cmd, res)) {
+                ++result.errors;
+            }
+            return res;
+        }
+
+        /**
+         * Seek a cylinder, and wait for the end of the seek.
+         */
+        void seek(uint8_t cylinder) {
+
+            if (cylinder) {
+                command(SEEK, {0x0F, 0x00, cylinder});
+            } else {
+                command(RECALIBRATE, {0x07, 0x00});
+            }
+
+            // The ROM senses the interrupt until Seek End is reported.
+            for (size_t ii = 0; ii < 100000; ++ii) {
+                vector<uint8_t> res = command(SENSE_INT, {0x08});
+                if (!res.empty() && (res[0] & 0x20)) {
+                    break;
+                }
+            }
+        }
+
+        /** Clocks elapsed in this session. */
+        uint64_t clocks = 0;
+
+    private:
+        /**
+         * Check the result of a command, like the ROM routines do.
+         *
+         * Reads and writes end with End of Cylinder, because there is no
+         * Terminal Count signal. This is not an error.
+         */
+        static bool failed(Command cmd, vector<uint8_t> const& res) {
+
+            switch (cmd) {
+                case READ_ID:
+                    return res.size() < 7 || (res[0] & 0xC0);
+                case READ_DATA:
+                case WRITE_DATA:
+                    return res.size() < 7 || (res[1] & 0x7F) || (res[2] & 0x7F);
+                default:
+                    return false;
+            }
+        }
+
+        void tick() {
+
+            for (size_t ii = 0; ii < machine.poll; ++ii) {
+                if (!fdc.sleeping) {
+                    fdc.clock();
+                }
+            }
+            clocks += machine.poll;
+        }
+
+        /**
+         * Poll the main status register until the FDC requests a byte.
+         *
+         * @param mask Direction bit mask.
+         * @param value Expected direction.
+         */
+        void wait(uint_fast8_t mask, uint_fast8_t value) {
+
+            for (uint_fast8_t status = fdc.status();
+                    !(status & SREG_RQM) || (status & mask) != value;
+                    status = fdc.status()) {
+                tick();
+            }
+        }
+};
+
+/**
+ * The IDs of the sectors of a track, in physical order.
+ */
+vector<DSKFile::Track::Sector> sectorsOf(DSKFile const& image, size_t cylinder) {
+
+    size_t tr = image.numSides * cylinder;
+    if (tr >= image.tracks.size() || !image.tracks[tr].trackSize) {
+        return vector<DSKFile::Track::Sector>();
+    }
+    DSKFile::Track const& track = image.tracks[tr];
+    return vector<DSKFile::Track::Sector>(track.sectors.begin(),
+            track.sectors.begin() + min<size_t>(track.numSectors, track.sectors.size()));
+}
+
+void script(Session& session, DSKFile const& image) {
+
+    // Step rate 12ms, head unload 240ms, head load 4ms, non-DMA.
+    session.command(SPECIFY, {0x03, 0xAF, 0x03});
+    session.seek(0);
+    session.command(READ_ID, {0x4A, 0x00});
+
+    // Catalogue: the first four sectors of track 0, by ID.
+    vector<DSKFile::Track::Sector> sectors = sectorsOf(image, 0);
+    sort(sectors.begin(), sectors.end(),
+            [](DSKFile::Track::Sector const& a, DSKFile::Track::Sector const& b) {
+                return a.sectorId < b.sectorId;
+            });
+    for (size_t ii = 0; ii < sectors.size() && ii < 4; ++ii) {
+        DSKFile::Track::Sector const& s = sectors[ii];
+        session.command(READ_DATA, {0x46, 0x00, static_cast<uint8_t>(s.track),
+                static_cast<uint8_t>(s.side), static_cast<uint8_t>(s.sectorId),
+                static_cast<uint8_t>(s.sectorSize), static_cast<uint8_t>(s.sectorId),
+                0x2A, 0xFF});
+    }
+
+    // Read every sector of the disk, in physical order.
+    for (size_t cc = 0; cc < image.numTracks; ++cc) {
+        session.seek(static_cast<uint8_t>(cc));
+        session.command(READ_ID, {0x4A, 0x00});
+        for (DSKFile::Track::Sector const& s : sectorsOf(image, cc)) {
+            session.command(READ_DATA, {0x46, 0x00, static_cast<uint8_t>(s.track),
+                    static_cast<uint8_t>(s.side), static_cast<uint8_t>(s.sectorId),
+                    static_cast<uint8_t>(s.sectorSize), static_cast<uint8_t>(s.sectorId),
+                    0x2A, 0xFF});
+        }
+    }
+
+    // Write the sectors of the first tracks. The drive has its own copy of
+    // the image, and write back is disabled, so the file is not modified.
+    for (size_t cc = 0; cc < image.numTracks && cc < 4; ++cc) {
+        session.seek(static_cast<uint8_t>(cc));
+        for (DSKFile::Track::Sector const& s : sectorsOf(image, cc)) {
+            vector<uint8_t> data(0x80 << min<uint_fast8_t>(s.sectorSize, 6),
+                    static_cast<uint8_t>(s.sectorId ^ cc));
+            session.command(WRITE_DATA, {0x45, 0x00, static_cast<uint8_t>(s.track),
+                    static_cast<uint8_t>(s.side), static_cast<uint8_t>(s.sectorId),
+                    static_cast<uint8_t>(s.sectorSize), static_cast<uint8_t>(s.sectorId),
+                    0x2A, 0xFF}, data);
+        }
+    }
+}
+
+bool benchmark(string const& fileName, Machine const& machine, bool fast,
+        size_t repeats, Result& result) {
+
+    // The disk classes report what they do on the console. Keep the
+    // output clean.
+    ostringstream discard;
+    streambuf* console = cout.rdbuf(discard.rdbuf());
+
+    DSKFile image;
+    image.load(fileName);
+    image.share();
+
+    for (size_t ii = 0; image.validFile && ii < repeats; ++ii) {
+        Session session(machine, image, fast);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        script(session, image);
+        result.host += seconds(start);
+        result.total += session.clocks;
+
+        for (size_t cc = 0; cc < NUM_COMMANDS; ++cc) {
+            result.count[cc] += session.result.count[cc];
+            result.clocks[cc] += session.result.clocks[cc];
+            result.time[cc] += session.result.time[cc];
+        }
+        result.bytes += session.result.bytes;
+        result.errors += session.result.errors;
+        discard.str("");
+    }
+
+    cout.rdbuf(console);
+    return image.validFile;
+}
+
+void report(string const& name, Machine const& machine, bool fast, Result const& result) {
+
+    double emulated = result.total / (machine.clockFrequency * 1e6);
+    cout << left << setw(24) << name.substr(0, 23)
+        << setw(10) << machine.name
+        << setw(10) << (fast ? "fast" : "accurate") << right << fixed
+        << setw(10) << setprecision(2) << emulated
+        << setw(10) << setprecision(3) << result.host
+        << setw(11) << setprecision(1) << rate(emulated, result.host)
+        << setw(11) << setprecision(1) << rate(result.bytes, result.host) / 1e6
+        << setw(8) << result.errors << endl;
+
+    for (size_t cc = 0; cc < NUM_COMMANDS; ++cc) {
+        if (result.count[cc]) {
+            cout << "    " << left << setw(14) << commandNames[cc] << right
+                << setw(8) << result.count[cc]
+                << setw(12) << setprecision(2) << 1e6 * result.time[cc] / result.count[cc]
+                << " us/cmd"
+                << setw(12) << setprecision(3)
+                << result.clocks[cc] / (machine.clockFrequency * 1e3) / result.count[cc]
+                << " emulated ms/cmd" << endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    size_t repeats = 1;
+    vector<string> files;
+    for (int ii = 1; ii < argc; ++ii) {
+        string arg(argv[ii]);
+        if (arg == "-r" && ii + 1 < argc) {
+            repeats = max(1L, strtol(argv[++ii], nullptr, 10));
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        cout << "Usage: " << argv[0] << " [-r repeats] diskfiles..." << endl;
+        return 1;
+    }
+
+    cout << left << setw(24) << "File"
+        << setw(10) << "Machine"
+        << setw(10) << "Mode" << right
+        << setw(10) << "Emul/s"
+        << setw(10) << "Host/s"
+        << setw(11) << "Emul/Host"
+        << setw(11) << "Data MB/s"
+        << setw(8) << "Errors" << endl;
+
+    size_t disks = 0;
+    for (string const& fileName : files) {
+        size_t slash = fileName.find_last_of("/\\");
+        string name = (slash != string::npos) ? fileName.substr(slash + 1) : fileName;
+
+        bool ok = true;
+        for (Machine const& machine : machines) {
+            for (bool fast : {false, true}) {
+                Result result;
+                ok = ok && benchmark(fileName, machine, fast, repeats, result);
+                if (ok) {
+                    report(name, machine, fast, result);
+                }
+            }
+        }
+
+        if (ok) {
+            ++disks;
+        } else {
+            cout << "Cannot benchmark " << fileName << endl;
+        }
+    }
+
+    return disks ? 0 : 1;
+}
+
+// EOF
+// vim: et:sw=4:ts=4
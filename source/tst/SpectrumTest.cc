@@ -3,12 +3,206 @@
 #include <boost/test/unit_test.hpp>
 //#include <boost/test/included/unit_test.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
 #include "Spectrum.h"
 
+using namespace std;
+
+// SpecIde.cc is not linked. The loader below does not need the ROMs.
+vector<string> getRomDirs() {
+
+    return vector<string>(1, "");
+}
+
+// A tape loader in the style of the ROM LD-BYTES, loaded at $8000. It reads
+// a whole TAP block (flag, data and parity) to $9000.
+uint8_t const loader[] = {
+    0xF3,                   // 8000 DI
+    0x31, 0x00, 0xFF,       // 8001 LD SP,$FF00
+    0xDD, 0x21, 0x00, 0x90, // 8004 LD IX,$9000
+    0x11, 0x00, 0x00,       // 8008 LD DE,length
+    0x3E, 0x7F,             // 800B LD A,$7F
+    0xDB, 0xFE,             // 800D IN A,($FE)
+    0x1F,                   // 800F RRA
+    0xE6, 0x20,             // 8010 AND $20
+    0x4F,                   // 8012 LD C,A
+    0x26, 0x00,             // 8013 LEADER0: LD H,$00
+    0x06, 0x9C,             // 8015 LEADER: LD B,$9C
+    0xCD, 0x55, 0x80,       // 8017 CALL EDGE2
+    0x30, 0xF7,             // 801A JR NC,LEADER0
+    0x3E, 0xC6,             // 801C LD A,$C6
+    0xB8,                   // 801E CP B
+    0x30, 0xF2,             // 801F JR NC,LEADER0
+    0x24,                   // 8021 INC H
+    0x20, 0xF1,             // 8022 JR NZ,LEADER
+    0x06, 0xC9,             // 8024 SYNC: LD B,$C9
+    0xCD, 0x59, 0x80,       // 8026 CALL EDGE1
+    0x30, 0xE8,             // 8029 JR NC,LEADER0
+    0x78,                   // 802B LD A,B
+    0xFE, 0xD4,             // 802C CP $D4
+    0x30, 0xF4,             // 802E JR NC,SYNC
+    0xCD, 0x59, 0x80,       // 8030 CALL EDGE1
+    0x30, 0xDE,             // 8033 JR NC,LEADER0
+    0x2E, 0x01,             // 8035 BYTE: LD L,$01
+    0x06, 0xB2,             // 8037 LD B,$B2
+    0xCD, 0x55, 0x80,       // 8039 BITS: CALL EDGE2
+    0x30, 0x15,             // 803C JR NC,FAIL
+    0x3E, 0xCB,             // 803E LD A,$CB
+    0xB8,                   // 8040 CP B
+    0xCB, 0x15,             // 8041 RL L
+    0x06, 0xB0,             // 8043 LD B,$B0
+    0x30, 0xF2,             // 8045 JR NC,BITS
+    0xDD, 0x75, 0x00,       // 8047 LD (IX+0),L
+    0xDD, 0x23,             // 804A INC IX
+    0x1B,                   // 804C DEC DE
+    0x7A,                   // 804D LD A,D
+    0xB3,                   // 804E OR E
+    0x20, 0xE4,             // 804F JR NZ,BYTE
+    0x18, 0xFE,             // 8051 DONE: JR DONE
+    0x18, 0xFE,             // 8053 FAIL: JR FAIL
+    0xCD, 0x59, 0x80,       // 8055 EDGE2: CALL EDGE1
+    0xD0,                   // 8058 RET NC
+    0x3E, 0x16,             // 8059 EDGE1: LD A,$16
+    0x3D,                   // 805B DELAY: DEC A
+    0x20, 0xFD,             // 805C JR NZ,DELAY
+    0xA7,                   // 805E AND A
+    0x04,                   // 805F SAMPLE: INC B
+    0xC8,                   // 8060 RET Z
+    0x3E, 0x7F,             // 8061 LD A,$7F
+    0xDB, 0xFE,             // 8063 IN A,($FE)
+    0x1F,                   // 8065 RRA
+    0xD0,                   // 8066 RET NC
+    0xA9,                   // 8067 XOR C
+    0xE6, 0x20,             // 8068 AND $20
+    0x28, 0xF3,             // 806A JR Z,SAMPLE
+    0x79,                   // 806C LD A,C
+    0x2F,                   // 806D CPL
+    0x4F,                   // 806E LD C,A
+    0x37,                   // 806F SCF
+    0xC9                    // 8070 RET
+};
+
+// The loader ends in a JR to itself.
+uint_fast16_t constexpr LOADER_DONE = 0x8051;
+size_t constexpr LOADER_FRAMES = 400;
+
+struct LoadResult {
+
+    size_t frames = 0;
+    vector<uint8_t> data;
+    uint_fast32_t cycles = 0;
+    vector<uint_fast16_t> regs;
+};
+
+LoadResult runLoader(string const& tapName, size_t length, bool edgeLoops) {
+
+    Spectrum spectrum;
+    spectrum.channel.open(2, 44100);
+    spectrum.setIssue3(RomVariant::ROM_48_EN);
+    spectrum.edgeLoops = edgeLoops;
+
+    for (size_t ii = 0; ii < sizeof(loader); ++ii) {
+        spectrum.writeMemory(0x8000 + ii, loader[ii]);
+    }
+    spectrum.writeMemory(0x8009, length & 0xFF);
+    spectrum.writeMemory(0x800A, length >> 8);
+    // Start the Z80 now, so the registers are cleared, and jump to it.
+    spectrum.z80.start();
+    spectrum.z80.state = Z80State::ST_OCF_T1H_ADDRWR;
+    spectrum.z80.pc.w = 0x8000;
+
+    spectrum.tape.loadTap(tapName);
+    spectrum.tape.play();
+
+    // Run a fixed number of frames, so both runs can be compared.
+    LoadResult result;
+    for (size_t ii = 0; ii < LOADER_FRAMES; ++ii) {
+        spectrum.run();
+        if (!result.frames && spectrum.z80.pc.w - LOADER_DONE < 3) {
+            result.frames = ii + 1;
+        }
+    }
+
+    for (size_t ii = 0; ii < length; ++ii) {
+        result.data.push_back(spectrum.readMemory(0x9000 + ii));
+    }
+    result.cycles = spectrum.ula.cycles;
+    result.regs = {spectrum.z80.pc.w, spectrum.z80.af.w, spectrum.z80.bc.w,
+        spectrum.z80.de.w, spectrum.z80.hl.w, spectrum.z80.ix.w,
+        spectrum.z80.ir.w, spectrum.z80.wz.w};
+    return result;
+}
+
 BOOST_AUTO_TEST_CASE(constructors_test)
 {
     Spectrum sp0;
 }
 
+BOOST_AUTO_TEST_CASE(snapshot_psg_test)
+{
+    // A 48K snapshot with an AY, playing a tone on channel A.
+    SaveState state;
+    state.type = SnapType::Z80_V3;
+    state.model = SnapshotModel::ZX_48K_ISSUE3;
+    state.emuAy8912 = true;
+    fill(&state.ayRegs[0], &state.ayRegs[16], 0x00);
+    state.ayRegs[0] = 0x34;
+    state.ayRegs[1] = 0x02;
+    state.ayRegs[7] = 0x3E;
+    state.ayRegs[8] = 0x0F;
+    state.port_0xfffd = 0x07;
+
+    Spectrum spectrum;
+    spectrum.loadState(state);
+
+    // The state derived from the registers follows them.
+    BOOST_CHECK_EQUAL(spectrum.psg.period[0][0], 0x234);
+    BOOST_CHECK_EQUAL(spectrum.psg.toneOff[0][0], 0);
+    BOOST_CHECK_EQUAL(spectrum.psg.toneOff[1][0], 1);
+    BOOST_CHECK_EQUAL(spectrum.psg.noiseOff[0][0], 1);
+    BOOST_CHECK_EQUAL(spectrum.psg.volume[0][0], 31);
+    BOOST_CHECK_EQUAL(spectrum.psg.a[0], 0x07);
+}
+
+BOOST_AUTO_TEST_CASE(edge_loop_test)
+{
+    // A TAP file with a single data block.
+    vector<uint8_t> block(1, 0xFF);
+    for (size_t ii = 0; ii < 64; ++ii) {
+        block.push_back(static_cast<uint8_t>(ii * 73 + 5));
+    }
+    uint8_t parity = 0;
+    for (uint8_t byte : block) {
+        parity ^= byte;
+    }
+    block.push_back(parity);
+
+    string tapName("edge_loop_test.tap");
+    ofstream ofs(tapName, ofstream::binary);
+    ofs.put(static_cast<char>(block.size() & 0xFF));
+    ofs.put(static_cast<char>(block.size() >> 8));
+    ofs.write(reinterpret_cast<char const*>(block.data()), block.size());
+    ofs.close();
+
+    LoadResult accurate = runLoader(tapName, block.size(), false);
+    LoadResult skipped = runLoader(tapName, block.size(), true);
+    remove(tapName.c_str());
+
+    // Both load the block.
+    BOOST_CHECK(accurate.frames);
+    BOOST_CHECK(accurate.data == block);
+    BOOST_CHECK(skipped.data == block);
+
+    // And the skipped iterations take the same time.
+    BOOST_CHECK_EQUAL(accurate.frames, skipped.frames);
+    BOOST_CHECK_EQUAL(accurate.cycles, skipped.cycles);
+    BOOST_CHECK(accurate.regs == skipped.regs);
+}
+
 // EOF
 // vim: et:sw=4:ts=4
@@ -0,0 +1,120 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TRDFile test
+#include <boost/test/unit_test.hpp>
+//#include <boost/test/included/unit_test.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FD1793.h"
+#include "TRDFile.h"
+
+using namespace std;
+
+BOOST_AUTO_TEST_CASE(empty_test)
+{
+    TRDFile file;
+    file.makeEmpty();
+
+    BOOST_CHECK(file.diskOk);
+    BOOST_CHECK_EQUAL(file.diskData.size(), 80 * 2 * TRD_TRACK_SIZE);
+    BOOST_CHECK_EQUAL(file.numFreeSectors, 2544);
+    BOOST_CHECK_EQUAL(file.freeSpaceAddress[1], 1);
+
+    // Sectors are numbered from 1 to 16, and sides are interleaved.
+    BOOST_CHECK(file.sector(0, 0, 0) == nullptr);
+    BOOST_CHECK(file.sector(0, 0, 17) == nullptr);
+    BOOST_CHECK(file.sector(80, 0, 1) == nullptr);
+    BOOST_CHECK(file.sector(0, 0, 9) == &file.diskData[TRD_INFO]);
+    BOOST_CHECK(file.sector(1, 1, 1) == &file.diskData[3 * TRD_TRACK_SIZE]);
+}
+
+BOOST_AUTO_TEST_CASE(save_test)
+{
+    string name = "trdtest.trd";
+    TRDFile file;
+    file.makeEmpty();
+    for (size_t ii = 0; ii < TRD_SECTOR_SIZE; ++ii) {
+        file.sector(39, 1, 7)[ii] = static_cast<uint8_t>(ii * 3);
+    }
+    BOOST_REQUIRE(file.save(name));
+
+    TRDFile other;
+    other.loadTRD(name);
+    BOOST_CHECK(other.diskOk);
+    BOOST_CHECK(other.diskData == file.diskData);
+    remove(name.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(scl_test)
+{
+    // Two files, of 3 and 14 sectors.
+    string name = "trdtest.scl";
+    vector<uint8_t> scl = {'S', 'I', 'N', 'C', 'L', 'A', 'I', 'R', 2};
+    vector<uint8_t> sizes = {3, 14};
+    for (uint8_t size : sizes) {
+        vector<uint8_t> header = {'F', 'I', 'L', 'E', ' ', ' ', ' ', ' ', 'C',
+            0x00, 0x80, 0x00, static_cast<uint8_t>(size - 1), size};
+        scl.insert(scl.end(), header.begin(), header.end());
+    }
+    for (uint8_t size : sizes) {
+        scl.insert(scl.end(), size * TRD_SECTOR_SIZE, size);
+    }
+    ofstream ofs(name.c_str(), ios::binary);
+    ofs.write(reinterpret_cast<char const*>(scl.data()), scl.size());
+    ofs.close();
+
+    TRDFile file;
+    file.loadSCL(name);
+    remove(name.c_str());
+
+    BOOST_REQUIRE(file.diskOk);
+    BOOST_CHECK_EQUAL(file.numFiles, 2);
+    BOOST_CHECK_EQUAL(file.numFreeSectors, 2544 - 17);
+
+    // The first file starts on track 1, and the second after it.
+    BOOST_CHECK_EQUAL(file.diskData[0x0E], 0);
+    BOOST_CHECK_EQUAL(file.diskData[0x0F], 1);
+    BOOST_CHECK_EQUAL(file.diskData[0x1E], 3);
+    BOOST_CHECK_EQUAL(file.diskData[0x1F], 1);
+    BOOST_CHECK_EQUAL(file.freeSpaceAddress[0], 1);
+    BOOST_CHECK_EQUAL(file.freeSpaceAddress[1], 2);
+
+    // Track 1 is side 1 of cylinder 0.
+    BOOST_CHECK_EQUAL(file.sector(0, 1, 3)[0xFF], 3);
+    BOOST_CHECK_EQUAL(file.sector(0, 1, 4)[0x00], 14);
+    BOOST_CHECK_EQUAL(file.sector(1, 0, 1)[0xFF], 14);
+}
+
+BOOST_AUTO_TEST_CASE(master_reset_test)
+{
+    FD1793 fdc;
+    fdc.fastMode = true;
+    fdc.drive[0].cylinder = 5;
+    fdc.trackReg = 5;
+
+    // Hold the Master Reset until the idle FD1793 goes to sleep.
+    fdc.write(0x07, 0x00);
+    for (size_t ii = 0; ii < 16 && !fdc.sleeping; ++ii) {
+        fdc.clock();
+    }
+    BOOST_REQUIRE(fdc.sleeping);
+
+    // Releasing it runs a Restore, which brings the head to track 0.
+    fdc.write(0x07, 0x04);
+    BOOST_CHECK(!fdc.sleeping);
+    for (size_t ii = 0; ii < 100000 && (fdc.read(0x00) & STATUS_BUSY); ++ii) {
+        if (!fdc.sleeping) {
+            fdc.clock();
+        }
+    }
+    BOOST_CHECK_EQUAL(fdc.read(0x00) & STATUS_BUSY, 0);
+    BOOST_CHECK_EQUAL(fdc.read(0x00) & STATUS_TRACK0, STATUS_TRACK0);
+    BOOST_CHECK_EQUAL(fdc.drive[0].cylinder, 0);
+    BOOST_CHECK_EQUAL(fdc.read(0x01), 0);
+}
+
+// vim: et:sw=4:ts=4
@@ -7,6 +7,7 @@
 #include <set>
 #include <vector>
 
+#include "PulseData.h"
 #include "TZXFile.h"
 
 using namespace std;
@@ -27,7 +28,7 @@ BOOST_AUTO_TEST_CASE(constructors_test)
 
 BOOST_AUTO_TEST_CASE(block_parsing_test)
 {
-    vector<uint32_t> pulseData;
+    PulseData pulseData;
     set<size_t> indexData;
     set<size_t> stopData;
     set<size_t> stopIf48K;
@@ -37,6 +38,82 @@ BOOST_AUTO_TEST_CASE(block_parsing_test)
     tzx.parse(pulseData, indexData, stopData, stopIf48K);
 }
 
+BOOST_AUTO_TEST_CASE(block_catalogue_test)
+{
+    PulseData pulseData;
+    set<size_t> indexData;
+    set<size_t> stopData;
+    set<size_t> stopIf48K;
+
+    TZXFile tzx;
+    tzx.load(boost::unit_test::framework::master_test_suite().argv[1]);
+    tzx.parse(pulseData, indexData, stopData, stopIf48K);
+
+    // Blocks are sorted and do not overlap.
+    size_t end = 0;
+    for (TapeBlock const& block : tzx.blocks) {
+        BOOST_CHECK_GE(block.start, end);
+        BOOST_CHECK_LT(block.start, block.end);
+        BOOST_CHECK_LE(block.end, pulseData.size());
+        BOOST_CHECK(block.data == SIZE_MAX || block.data < tzx.romData.size());
+        end = block.end;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pulse_data_pair_test)
+{
+    // A standard ROM block: pilot, sync pulses, data and pause.
+    vector<uint8_t> data;
+    for (size_t ii = 0; ii < 1024; ++ii) {
+        data.push_back(static_cast<uint8_t>(ii * 37 + (ii >> 3)));
+    }
+
+    PulseData pulseData;
+    pulseData.append(3223, 2168);
+    pulseData.push_back(667);
+    pulseData.push_back(735);
+    for (uint8_t byte : data) {
+        for (size_t jj = 0; jj < 8; ++jj) {
+            pulseData.append(2, (byte & 0x80) ? 1710 : 855);
+            byte <<= 1;
+        }
+    }
+    pulseData.push_back(945);
+    pulseData.push_back(3500);
+
+    // The data is stored one bit per pulse.
+    size_t pairPulses = 0;
+    for (PulseSegment const& segment : pulseData.segments) {
+        if (segment.type == PulseData::PAIR) {
+            pairPulses += segment.count;
+        }
+    }
+    BOOST_CHECK_GE(pairPulses, data.size() * 16 - 64);
+    BOOST_CHECK_LT(pulseData.bytes.size(), 128);
+    BOOST_CHECK_LT(pulseData.memory(), data.size() * 8);
+
+    // And reads back as the same bytes.
+    PulseCursor cursor;
+    pulseData.seek(cursor, 0);
+    for (size_t ii = 0; ii < 3223; ++ii) {
+        BOOST_CHECK_EQUAL(pulseData.next(cursor), 2168);
+    }
+    BOOST_CHECK_EQUAL(pulseData.next(cursor), 667);
+    BOOST_CHECK_EQUAL(pulseData.next(cursor), 735);
+    for (uint8_t byte : data) {
+        uint8_t read = 0;
+        for (size_t jj = 0; jj < 8; ++jj) {
+            uint32_t pulse = pulseData.next(cursor);
+            BOOST_CHECK_EQUAL(pulseData.next(cursor), pulse);
+            read = (read << 1) | ((pulse == 1710) ? 1 : 0);
+        }
+        BOOST_CHECK_EQUAL(read, byte);
+    }
+    BOOST_CHECK_EQUAL(pulseData.next(cursor), 945);
+    BOOST_CHECK_EQUAL(pulseData.next(cursor), 3500);
+    BOOST_CHECK_EQUAL(pulseData.size(), 3223 + 2 + data.size() * 16 + 2);
+}
+
 // EOF
 // vim: et:sw=4:ts=4
 
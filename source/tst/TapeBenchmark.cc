@@ -0,0 +1,198 @@
+/* This file is part of SpecIde, (c) Marta Sevillano Mancilla, 2016-2024.
+ *
+ * SpecIde is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * SpecIde is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SpecIde.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/** TapeBenchmark
+ *
+ * Measures the tape subsystem on a corpus of tape files, without a window.
+ *
+ * Usage: TapeBenchmark [-r repeats] tapefiles...
+ *
+ * For each file it reports the parsing speed (file bytes per second, with
+ * TZX, CDT and CSW files decoded completely), the playback speed (pulses
+ * per second through Tape::advance), and the memory used by the tape.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FileView.h"
+#include "Tape.h"
+
+using namespace std;
+
+struct Result {
+
+    size_t bytes = 0;       // File size.
+    size_t pulses = 0;      // Pulses in the tape.
+    size_t memory = 0;      // Memory used by the tape.
+    uint64_t cycles = 0;    // Tape length, in 3.5MHz T-states.
+    double parse = 0.0;     // Seconds spent parsing.
+    double play = 0.0;      // Seconds spent playing.
+};
+
+bool loadTape(Tape& tape, string const& fileName) {
+
+    size_t dot = fileName.find_last_of('.');
+    string extension = (dot != string::npos) ? fileName.substr(dot) : "";
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == ".tzx") {
+        tape.loadTzx(fileName);
+    } else if (extension == ".cdt") {
+        tape.loadCdt(fileName);
+    } else if (extension == ".tap") {
+        tape.loadTap(fileName);
+    } else if (extension == ".pzx") {
+        tape.loadPzx(fileName);
+    } else if (extension == ".csw") {
+        tape.loadCsw(fileName);
+    } else {
+        return false;
+    }
+
+    // Decode the whole file, so parsing is measured completely.
+    tape.decode(SIZE_MAX);
+    return true;
+}
+
+double seconds(chrono::steady_clock::time_point start) {
+
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+double rate(double count, double time) {
+
+    return (time > 0.0) ? count / time : 0.0;
+}
+
+bool benchmark(string const& fileName, size_t repeats, Result& result) {
+
+    FileView file;
+    if (!file.open(fileName)) {
+        return false;
+    }
+    result.bytes = file.size();
+    file.close();
+
+    // Tape reports what it does on the console. Keep the output clean.
+    ostringstream discard;
+    streambuf* console = cout.rdbuf(discard.rdbuf());
+
+    bool ok = true;
+    for (size_t ii = 0; ok && ii < repeats; ++ii) {
+        Tape tape;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        ok = loadTape(tape, fileName);
+        result.parse += seconds(start);
+
+        // Play the whole tape. The loop is the same as the emulated
+        // machines do, without the clock.
+        uint64_t cycles = 0;
+        start = chrono::steady_clock::now();
+        while (tape.pointer < tape.pulseData.size()) {
+            tape.advance();
+            cycles += tape.sample;
+        }
+        result.play += seconds(start);
+
+        result.pulses = tape.pulseData.size();
+        result.memory = tape.memory();
+        result.cycles = cycles / 2;
+
+        discard.str("");
+    }
+
+    cout.rdbuf(console);
+    return ok && result.pulses;
+}
+
+void report(string const& name, Result const& result, size_t repeats) {
+
+    cout << left << setw(32) << name.substr(0, 31) << right << fixed
+        << setw(11) << result.bytes
+        << setw(12) << result.pulses
+        << setw(11) << setprecision(1) << result.cycles / 3500000.0
+        << setw(11) << setprecision(2) << rate(result.bytes * repeats, result.parse) / 1e6
+        << setw(11) << setprecision(2) << rate(result.pulses * repeats, result.play) / 1e6
+        << setw(11) << setprecision(1) << result.memory / 1024.0
+        << setw(9) << setprecision(2)
+        << (result.bytes ? static_cast<double>(result.memory) / result.bytes : 0.0)
+        << endl;
+}
+
+int main(int argc, char* argv[]) {
+
+    size_t repeats = 1;
+    vector<string> files;
+    for (int ii = 1; ii < argc; ++ii) {
+        string arg(argv[ii]);
+        if (arg == "-r" && ii + 1 < argc) {
+            repeats = max(1L, strtol(argv[++ii], nullptr, 10));
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        cout << "Usage: " << argv[0] << " [-r repeats] tapefiles..." << endl;
+        return 1;
+    }
+
+    cout << left << setw(32) << "File" << right
+        << setw(11) << "Bytes"
+        << setw(12) << "Pulses"
+        << setw(11) << "Length/s"
+        << setw(11) << "Parse MB/s"
+        << setw(11) << "Play Mp/s"
+        << setw(11) << "Mem/KB"
+        << setw(9) << "Mem/B" << endl;
+
+    Result total;
+    size_t tapes = 0;
+    for (string const& fileName : files) {
+        Result result;
+        if (!benchmark(fileName, repeats, result)) {
+            cout << "Cannot benchmark " << fileName << endl;
+            continue;
+        }
+
+        size_t slash = fileName.find_last_of("/\\");
+        report((slash != string::npos) ? fileName.substr(slash + 1) : fileName, result, repeats);
+
+        total.bytes += result.bytes;
+        total.pulses += result.pulses;
+        total.memory += result.memory;
+        total.cycles += result.cycles;
+        total.parse += result.parse;
+        total.play += result.play;
+        ++tapes;
+    }
+
+    if (tapes > 1) {
+        report("Total", total, repeats);
+    }
+    return tapes ? 0 : 1;
+}
+
+// EOF
+// vim: et:sw=4:ts=4
@@ -0,0 +1,94 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE TapeRecorder test
+#include <boost/test/unit_test.hpp>
+//#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Tape.h"
+#include "TapeRecorder.h"
+
+using namespace std;
+
+// Record some pulses, with the time stamps of a 7MHz clock, and save them.
+vector<uint32_t> record(string const& fileName) {
+
+    vector<uint32_t> pulses(1, 3500);
+    pulses.insert(pulses.end(), 64, 2168);
+    pulses.push_back(667);
+    pulses.push_back(735);
+    for (size_t ii = 0; ii < 32; ++ii) {
+        uint32_t bit = (ii * 37) & 0x04 ? 1710 : 855;
+        pulses.push_back(bit);
+        pulses.push_back(bit);
+    }
+    pulses.push_back(40000);
+    pulses.push_back(1);
+    pulses.push_back(945);
+
+    TapeRecorder recorder;
+    uint32_t time = 0xFFFF0000;     // Time stamps wrap.
+    recorder.start(7000000.0, time);
+    bool mic = false;
+    for (uint32_t pulse : pulses) {
+        time += 2 * pulse;
+        mic = !mic;
+        recorder.write(mic, time);
+        recorder.frame(time);
+    }
+
+    // The last level lasts until the recording is saved.
+    time += 2 * 3000;
+    recorder.frame(time);
+    pulses.push_back(3000);
+
+    BOOST_CHECK(recorder.save(fileName));
+    return pulses;
+}
+
+// Read the pulses back. Loaders may add pulses at the end of the tape.
+vector<uint32_t> pulses(Tape& tape, size_t count) {
+
+    tape.decode(SIZE_MAX);
+
+    vector<uint32_t> read;
+    PulseCursor cursor;
+    tape.pulseData.seek(cursor, 0);
+    for (size_t ii = 0; ii < min(count, tape.pulseData.size()); ++ii) {
+        read.push_back(tape.pulseData.next(cursor));
+    }
+    return read;
+}
+
+BOOST_AUTO_TEST_CASE(pzx_test)
+{
+    string fileName("tape_recorder_test.pzx");
+    vector<uint32_t> recorded = record(fileName);
+
+    Tape tape;
+    tape.loadPzx(fileName);
+    remove(fileName.c_str());
+
+    vector<uint32_t> read = pulses(tape, recorded.size());
+    BOOST_CHECK(read == recorded);
+}
+
+BOOST_AUTO_TEST_CASE(csw_test)
+{
+    string fileName("tape_recorder_test.csw");
+    vector<uint32_t> recorded = record(fileName);
+
+    Tape tape;
+    tape.loadCsw(fileName);
+    remove(fileName.c_str());
+
+    vector<uint32_t> read = pulses(tape, recorded.size());
+    BOOST_CHECK(read == recorded);
+}
+
+// EOF
+// vim: et:sw=4:ts=4
@@ -55,16 +55,18 @@ uint8_t z80V1Header[] {
 BOOST_AUTO_TEST_CASE(v1_header_test)
 {
     Z80File file;
+    vector<uint8_t> bytes;
     for (uint32_t ii = 0; ii < 0x100; ++ii) {
-        file.fileData.push_back(0xED);
-        file.fileData.push_back(0xED);
-        file.fileData.push_back(0xFF);
-        file.fileData.push_back(ii);
+        bytes.push_back(0xED);
+        bytes.push_back(0xED);
+        bytes.push_back(0xFF);
+        bytes.push_back(ii);
     }
-    file.fileData.push_back(0x00);
-    file.fileData.push_back(0xED);
-    file.fileData.push_back(0xED);
-    file.fileData.push_back(0x00);
+    bytes.push_back(0x00);
+    bytes.push_back(0xED);
+    bytes.push_back(0xED);
+    bytes.push_back(0x00);
+    file.fileData.assign(std::move(bytes));
 
     BOOST_CHECK_EQUAL(file.checkVersion(), true);
     BOOST_CHECK_EQUAL(file.parseHeader(), true);